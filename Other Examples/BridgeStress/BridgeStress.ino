@@ -0,0 +1,74 @@
+/* HomeSpan Bridge Stress Test */
+
+// Creates a Bridge with NUM_ACCESSORIES identical Accessories so you can see how much memory a large
+// database needs on your particular ESP32.  The 'i' CLI command (also run automatically at start-up)
+// prints the estimated memory budget, including the size of the /accessories response and the approximate
+// maximum number of Accessories of this size the device can support.  Change NUM_ACCESSORIES (up to the
+// HAP limit of 149 bridged Accessories) to see how the estimates scale, and confirm the device stays responsive after pairing.
+//
+// The sketch also times construction of the database in blocks of BLOCK_SIZE Accessories.  Since the configuration
+// checks HomeSpan performs as each Accessory, Service, and Characteristic is added do not depend on how many have already
+// been created, the time per block should stay roughly constant as the bridge grows (i.e. total time scales linearly).
+
+#include "HomeSpan.h"         // include the HomeSpan library
+
+#define NUM_ACCESSORIES 149   // number of bridged Accessories (the Bridge Accessory itself also counts toward the HAP limit of 150)
+#define BLOCK_SIZE       25   // number of bridged Accessories per timing block
+
+void setup() {     
+ 
+  Serial.begin(115200);       // start the Serial interface
+
+  homeSpan.begin(Category::Bridges,"HomeSpan Stress Bridge");
+
+  new SpanAccessory();                                // Bridge Accessory
+    new Service::AccessoryInformation();
+      new Characteristic::Name("Stress Bridge");
+      new Characteristic::Manufacturer("HomeSpan");
+      new Characteristic::SerialNumber("BRIDGE-000");
+      new Characteristic::Model("Stress Test");
+      new Characteristic::FirmwareRevision("1.0");
+      new Characteristic::Identify();
+    new Service::HAPProtocolInformation();
+      new Characteristic::Version("1.1.0");
+
+  char name[32];
+  char serial[32];
+
+  Serial.printf("\n%-12s  %10s  %14s\n","Accessories","Block (us)","Per Accessory");
+  Serial.printf("%-12s  %10s  %14s\n","-----------","----------","-------------");
+
+  uint32_t blockStart=micros();
+
+  for(int i=1;i<=NUM_ACCESSORIES;i++){
+
+    sprintf(name,"Light %d",i);                       // Characteristics keep their own copy of string values, so these buffers can be re-used
+    sprintf(serial,"LIGHT-%03d",i);
+    
+    new SpanAccessory();                              // a typical bridged Accessory: information plus a dimmable Light Bulb
+      new Service::AccessoryInformation();
+        new Characteristic::Name(name);
+        new Characteristic::Manufacturer("HomeSpan");
+        new Characteristic::SerialNumber(serial);
+        new Characteristic::Model("Dimmable Light");
+        new Characteristic::FirmwareRevision("1.0");
+        new Characteristic::Identify();
+      new Service::LightBulb();
+        new Characteristic::On();
+        new Characteristic::Brightness(50);
+
+    if(i%BLOCK_SIZE==0 || i==NUM_ACCESSORIES){        // print time taken to build this block of Accessories
+      uint32_t blockTime=micros()-blockStart;
+      int n=(i%BLOCK_SIZE)?(i%BLOCK_SIZE):BLOCK_SIZE;
+      Serial.printf("%-12d  %10u  %14u\n",i,blockTime,blockTime/n);
+      blockStart=micros();                            // exclude time spent printing
+    }
+  }
+
+} // end of setup()
+
+void loop(){
+
+  homeSpan.poll(); 
+
+} // end of loop()
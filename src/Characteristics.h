@@ -59,131 +59,175 @@ struct HapChar {
   PERMS perms;
   FORMAT format;
   boolean staticRange;
+  uint32_t typeNum;       // short-form numeric type (e.g. 0x25), or 0 if type is a custom 128-bit UUID
+  uint8_t index;          // position of this Characteristic in HapCharacteristics, used as its bit number in a HapMask (left as 0 in a five-field custom HapChar)
+  double minValue;        // default minimum value (not applicable for STRING or BOOL)
+  double maxValue;        // default maximum value (not applicable for STRING or BOOL)
+
+  enum {CUSTOM=0xFF};     // index reported by HapCharacteristics::indexOf() for a custom HapChar defined in a sketch
+
+  boolean hasRange() const {return(minValue<=maxValue && (minValue!=0 || maxValue!=0));}    // returns true if a default range is specified (NaN, min>max, and the [0,0] left by a five-field custom HapChar all mean no range)
 };
 
 ///////////////////////////////
 
-#define HAPCHAR(hapName,type,perms,format,staticRange)  HapChar hapName {#type,#hapName,(PERMS)(perms),format,staticRange}
+#define HAPCHAR(hapName,type,perms,format,staticRange,minValue,maxValue)  enum {hapName##_index=__COUNTER__-FIRST_INDEX-1}; HapChar hapName {#type,#hapName,(PERMS)(perms),format,staticRange,0x##type,hapName##_index,minValue,maxValue}
+#define HAPTYPE(type)  #type,0x##type                   // expands short-form type into both the string and numeric forms used by SpanService
 
 struct HapCharacteristics {
+
+  enum {FIRST_INDEX=__COUNTER__};       // HAPCHAR() numbers each Characteristic consecutively from zero, relative to this counter value
   
-  HAPCHAR( Active, B0, PW+PR+EV, UINT8, true );
-  HAPCHAR( ActiveIdentifier, E7, PW+PR+EV, UINT32, true );
-  HAPCHAR( AirQuality, 95, PR+EV, UINT8, true );
-  HAPCHAR( BatteryLevel, 68, PR+EV, UINT8, false );
-  HAPCHAR( Brightness, 8, PR+PW+EV, INT, false );
-  HAPCHAR( CarbonMonoxideLevel, 90, PR+EV, FLOAT, false );
-  HAPCHAR( CarbonMonoxidePeakLevel, 91, PR+EV, FLOAT, false );
-  HAPCHAR( CarbonDioxideDetected, 92, PR+EV, UINT8, true );
-  HAPCHAR( CarbonDioxideLevel, 93, PR+EV, FLOAT, false );
-  HAPCHAR( CarbonDioxidePeakLevel, 94, PR+EV, FLOAT, false );
-  HAPCHAR( CarbonMonoxideDetected, 69, PR+EV, UINT8, true );
-  HAPCHAR( ChargingState, 8F, PR+EV, UINT8, true );
-  HAPCHAR( ClosedCaptions, DD, PW+PR+EV, UINT8, true );
-  HAPCHAR( CoolingThresholdTemperature, D, PR+PW+EV, FLOAT, false );
-  HAPCHAR( ColorTemperature, CE, PR+PW+EV, UINT32, false );
-  HAPCHAR( ConfiguredName, E3, PW+PR+EV, STRING, false );
-  HAPCHAR( ContactSensorState, 6A, PR+EV, UINT8, true );
-  HAPCHAR( CurrentAmbientLightLevel, 6B, PR+EV, FLOAT, false );
-  HAPCHAR( CurrentHorizontalTiltAngle, 6C, PR+EV, INT, false );  
-  HAPCHAR( CurrentAirPurifierState, A9, PR+EV, UINT8, true  );
-  HAPCHAR( CurrentSlatState, AA, PR+EV, UINT8, true );
-  HAPCHAR( CurrentPosition, 6D, PR+EV, UINT8, false );
-  HAPCHAR( CurrentVerticalTiltAngle, 6E, PR+EV, INT, false );  
-  HAPCHAR( CurrentHumidifierDehumidifierState, B3, PR+EV, UINT8, true );    
-  HAPCHAR( CurrentDoorState, E, PR+EV, UINT8, true );
-  HAPCHAR( CurrentFanState, AF, PR+EV, UINT8, true );
-  HAPCHAR( CurrentHeatingCoolingState, F, PR+EV, UINT8, true );
-  HAPCHAR( CurrentHeaterCoolerState, B1, PR+EV, UINT8, true );
-  HAPCHAR( CurrentMediaState, E0, PR+EV, UINT8, true );
-  HAPCHAR( CurrentRelativeHumidity, 10, PR+EV, FLOAT, false ); 
-  HAPCHAR( CurrentTemperature, 11, PR+EV, FLOAT, false );
-  HAPCHAR( CurrentTiltAngle, C1, PR+EV, INT, false );
-  HAPCHAR( CurrentVisibilityState, 135, PR+EV, UINT8, true );
-//  HAPCHAR( DisplayOrder, 136, PW+PR+EV, TLV8, false );
-  HAPCHAR( FilterLifeLevel, AB, PR+EV, FLOAT, false );
-  HAPCHAR( FilterChangeIndication, AC, PR+EV, UINT8, true );
-  HAPCHAR( FirmwareRevision, 52, PR, STRING, true );
-  HAPCHAR( HardwareRevision, 53, PR, STRING, true );
-  HAPCHAR( HeatingThresholdTemperature, 12, PR+PW+EV, FLOAT, false );
-  HAPCHAR( HoldPosition, 6F, PW, BOOL, true );
-  HAPCHAR( Hue, 13, PR+PW+EV, FLOAT, false );
-  HAPCHAR( Identify, 14, PW, BOOL, true );
-  HAPCHAR( Identifier, E6, PR, UINT32, true );
-  HAPCHAR( InputDeviceType, DC, PR+EV, UINT8, true );
-  HAPCHAR( InputSourceType, DB, PR+EV, UINT8, true );
-  HAPCHAR( InUse, D2, PR+EV, UINT8, true );
-  HAPCHAR( IsConfigured, D6, PR+EV, UINT8, true );
-  HAPCHAR( LeakDetected, 70, PR+EV, UINT8, true );  
-  HAPCHAR( LockCurrentState, 1D, PR+EV, UINT8, true );  
-  HAPCHAR( LockPhysicalControls, A7, PW+PR+EV, UINT8, true );
-  HAPCHAR( LockTargetState, 1E, PW+PR+EV, UINT8, true );  
-  HAPCHAR( Manufacturer, 20, PR, STRING, true );
-  HAPCHAR( Model, 21, PR, STRING, true );
-  HAPCHAR( MotionDetected, 22, PR+EV, BOOL, true );
-  HAPCHAR( Mute, 11A, PW+PR+EV, BOOL, true );
-  HAPCHAR( Name, 23, PR, STRING, true );
-  HAPCHAR( NitrogenDioxideDensity, C4, PR+EV, FLOAT, false );
-  HAPCHAR( ObstructionDetected, 24, PR+EV, BOOL, true );
-  HAPCHAR( PM25Density, C6, PR+EV, FLOAT, false );
-  HAPCHAR( OccupancyDetected, 71, PR+EV, UINT8, true );
-  HAPCHAR( OutletInUse, 26, PR+EV, BOOL, true );
-  HAPCHAR( On, 25, PR+PW+EV, BOOL, true );
-  HAPCHAR( OzoneDensity, C3, PR+EV, FLOAT, false );
-  HAPCHAR( PM10Density, C7, PR+EV, FLOAT, false );
-  HAPCHAR( PictureMode, E2, PW+PR+EV, UINT8, true );
-  HAPCHAR( PositionState, 72, PR+EV, UINT8, true );
-  HAPCHAR( PowerModeSelection, DF, PW, UINT8, true );
-  HAPCHAR( ProgramMode, D1, PR+EV, UINT8, true );
-  HAPCHAR( ProgrammableSwitchEvent, 73, PR+EV+NV, UINT8, true );
-  HAPCHAR( RelativeHumidityDehumidifierThreshold, C9, PR+PW+EV, FLOAT, false );
-  HAPCHAR( RelativeHumidityHumidifierThreshold, CA, PR+PW+EV, FLOAT, false );
-  HAPCHAR( RemainingDuration, D4, PR+EV, UINT32, false );
-  HAPCHAR( RemoteKey, E1, PW, UINT8, true );
-  HAPCHAR( ResetFilterIndication, AD, PW, UINT8, true );
-  HAPCHAR( RotationDirection, 28, PR+PW+EV, INT, true );
-  HAPCHAR( RotationSpeed, 29, PR+PW+EV, FLOAT, false );
-  HAPCHAR( Saturation, 2F, PR+PW+EV, FLOAT, false );  
-  HAPCHAR( SecuritySystemAlarmType, 8E, PR+EV, UINT8, true );  
-  HAPCHAR( SecuritySystemCurrentState, 66, PR+EV, UINT8, true );  
-  HAPCHAR( SecuritySystemTargetState, 67, PW+PR+EV, UINT8, true  );  
-  HAPCHAR( SerialNumber, 30, PR, STRING, true );
-  HAPCHAR( ServiceLabelIndex, CB, PR, UINT8, true );
-  HAPCHAR( ServiceLabelNamespace, CD, PR, UINT8, true );
-  HAPCHAR( SlatType, C0, PR, UINT8, true );
-  HAPCHAR( SleepDiscoveryMode, E8, PR+EV, UINT8, true );
-  HAPCHAR( SmokeDetected, 76, PR+EV, UINT8, true );
-  HAPCHAR( StatusActive, 75, PR+EV, BOOL, true );
-  HAPCHAR( StatusFault, 77, PR+EV, UINT8, true );
-  HAPCHAR( StatusJammed, 78, PR+EV, UINT8, true );
-  HAPCHAR( StatusLowBattery, 79, PR+EV, UINT8, true );
-  HAPCHAR( StatusTampered, 7A, PR+EV, UINT8, true );
-  HAPCHAR( SulphurDioxideDensity, C5, PR+EV, FLOAT, false );
-  HAPCHAR( SwingMode, B6, PR+EV+PW, UINT8, true );
-  HAPCHAR( TargetAirPurifierState, A8, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetFanState, BF, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetTiltAngle, C2, PW+PR+EV, INT, false );
-  HAPCHAR( TargetHeaterCoolerState, B2, PW+PR+EV, UINT8, true );
-  HAPCHAR( SetDuration, D3, PW+PR+EV, UINT32, false );
-  HAPCHAR( TargetHorizontalTiltAngle, 7B, PW+PR+EV, INT, false );
-  HAPCHAR( TargetHumidifierDehumidifierState, B4, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetPosition, 7C, PW+PR+EV, UINT8, false );
-  HAPCHAR( TargetDoorState, 32, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetHeatingCoolingState, 33, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetMediaState, 137, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetRelativeHumidity, 34, PW+PR+EV, FLOAT, false );
-  HAPCHAR( TargetTemperature, 35, PW+PR+EV, FLOAT, false );
-  HAPCHAR( TargetVisibilityState, 134, PW+PR+EV, UINT8, true );
-  HAPCHAR( TemperatureDisplayUnits, 36, PW+PR+EV, UINT8, true );
-  HAPCHAR( TargetVerticalTiltAngle, 7D, PW+PR+EV, INT, false );
-  HAPCHAR( ValveType, D5, PR+EV, UINT8, true );  
-  HAPCHAR( Version, 37, PR, STRING, true );
-  HAPCHAR( VOCDensity, C8, PR+EV, FLOAT, false );   
-  HAPCHAR( Volume, 119, PW+PR+EV, UINT8, false );
-  HAPCHAR( VolumeControlType, E9, PR+EV, UINT8, true );
-  HAPCHAR( VolumeSelector, EA, PR+EV, UINT8, true );
-  HAPCHAR( WaterLevel, B5, PR+EV, FLOAT, false );
+  HAPCHAR( Active, B0, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( ActiveIdentifier, E7, PW+PR+EV, UINT32, true, 0, 255 );
+  HAPCHAR( AirQuality, 95, PR+EV, UINT8, true, 0, 5 );
+  HAPCHAR( BatteryLevel, 68, PR+EV, UINT8, false, 0, 100 );
+  HAPCHAR( Brightness, 8, PR+PW+EV, INT, false, 0, 100 );
+  HAPCHAR( CarbonMonoxideLevel, 90, PR+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( CarbonMonoxidePeakLevel, 91, PR+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( CarbonDioxideDetected, 92, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( CarbonDioxideLevel, 93, PR+EV, FLOAT, false, 0, 100000 );
+  HAPCHAR( CarbonDioxidePeakLevel, 94, PR+EV, FLOAT, false, 0, 100000 );
+  HAPCHAR( CarbonMonoxideDetected, 69, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( ChargingState, 8F, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( ClosedCaptions, DD, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( CoolingThresholdTemperature, D, PR+PW+EV, FLOAT, false, 10, 35 );
+  HAPCHAR( ColorTemperature, CE, PR+PW+EV, UINT32, false, 140, 500 );
+  HAPCHAR( ConfiguredName, E3, PW+PR+EV, STRING, false, 0, 1 );
+  HAPCHAR( ContactSensorState, 6A, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( CurrentAmbientLightLevel, 6B, PR+EV, FLOAT, false, 0.0001, 100000 );
+  HAPCHAR( CurrentHorizontalTiltAngle, 6C, PR+EV, INT, false, -90, 90 );  
+  HAPCHAR( CurrentAirPurifierState, A9, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( CurrentSlatState, AA, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( CurrentPosition, 6D, PR+EV, UINT8, false, 0, 100 );
+  HAPCHAR( CurrentVerticalTiltAngle, 6E, PR+EV, INT, false, -90, 90 );  
+  HAPCHAR( CurrentHumidifierDehumidifierState, B3, PR+EV, UINT8, true, 0, 3 );    
+  HAPCHAR( CurrentDoorState, E, PR+EV, UINT8, true, 0, 4 );
+  HAPCHAR( CurrentFanState, AF, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( CurrentHeatingCoolingState, F, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( CurrentHeaterCoolerState, B1, PR+EV, UINT8, true, 0, 3 );
+  HAPCHAR( CurrentMediaState, E0, PR+EV, UINT8, true, 0, 5 );
+  HAPCHAR( CurrentRelativeHumidity, 10, PR+EV, FLOAT, false, 0, 100 ); 
+  HAPCHAR( CurrentTemperature, 11, PR+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( CurrentTiltAngle, C1, PR+EV, INT, false, -90, 90 );
+  HAPCHAR( CurrentVisibilityState, 135, PR+EV, UINT8, true, 0, 1 );
+//  HAPCHAR( DisplayOrder, 136, PW+PR+EV, TLV8, false, 0, 1 );
+  HAPCHAR( FilterLifeLevel, AB, PR+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( FilterChangeIndication, AC, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( FirmwareRevision, 52, PR, STRING, true, 0, 1 );
+  HAPCHAR( HardwareRevision, 53, PR, STRING, true, 0, 1 );
+  HAPCHAR( HeatingThresholdTemperature, 12, PR+PW+EV, FLOAT, false, 0, 25 );
+  HAPCHAR( HoldPosition, 6F, PW, BOOL, true, 0, 1 );
+  HAPCHAR( Hue, 13, PR+PW+EV, FLOAT, false, 0, 360 );
+  HAPCHAR( Identify, 14, PW, BOOL, true, 0, 1 );
+  HAPCHAR( Identifier, E6, PR, UINT32, true, 0, 255 );
+  HAPCHAR( InputDeviceType, DC, PR+EV, UINT8, true, 0, 6 );
+  HAPCHAR( InputSourceType, DB, PR+EV, UINT8, true, 0, 10 );
+  HAPCHAR( InUse, D2, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( IsConfigured, D6, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( LeakDetected, 70, PR+EV, UINT8, true, 0, 1 );  
+  HAPCHAR( LockCurrentState, 1D, PR+EV, UINT8, true, 0, 3 );  
+  HAPCHAR( LockPhysicalControls, A7, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( LockTargetState, 1E, PW+PR+EV, UINT8, true, 0, 1 );  
+  HAPCHAR( Manufacturer, 20, PR, STRING, true, 0, 1 );
+  HAPCHAR( Model, 21, PR, STRING, true, 0, 1 );
+  HAPCHAR( MotionDetected, 22, PR+EV, BOOL, true, 0, 1 );
+  HAPCHAR( Mute, 11A, PW+PR+EV, BOOL, true, 0, 1 );
+  HAPCHAR( Name, 23, PR, STRING, true, 0, 1 );
+  HAPCHAR( NitrogenDioxideDensity, C4, PR+EV, FLOAT, false, 0, 1000 );
+  HAPCHAR( ObstructionDetected, 24, PR+EV, BOOL, true, 0, 1 );
+  HAPCHAR( PM25Density, C6, PR+EV, FLOAT, false, 0, 1000 );
+  HAPCHAR( OccupancyDetected, 71, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( OutletInUse, 26, PR+EV, BOOL, true, 0, 1 );
+  HAPCHAR( On, 25, PR+PW+EV, BOOL, true, 0, 1 );
+  HAPCHAR( OzoneDensity, C3, PR+EV, FLOAT, false, 0, 1000 );
+  HAPCHAR( PM10Density, C7, PR+EV, FLOAT, false, 0, 1000 );
+  HAPCHAR( PictureMode, E2, PW+PR+EV, UINT8, true, 0, 13 );
+  HAPCHAR( PositionState, 72, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( PowerModeSelection, DF, PW, UINT8, true, 0, 1 );
+  HAPCHAR( ProgramMode, D1, PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( ProgrammableSwitchEvent, 73, PR+EV+NV, UINT8, true, 0, 2 );
+  HAPCHAR( RelativeHumidityDehumidifierThreshold, C9, PR+PW+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( RelativeHumidityHumidifierThreshold, CA, PR+PW+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( RemainingDuration, D4, PR+EV, UINT32, false, 0, 3600 );
+  HAPCHAR( RemoteKey, E1, PW, UINT8, true, 0, 16 );
+  HAPCHAR( ResetFilterIndication, AD, PW, UINT8, true, 1, 1 );
+  HAPCHAR( RotationDirection, 28, PR+PW+EV, INT, true, 0, 1 );
+  HAPCHAR( RotationSpeed, 29, PR+PW+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( Saturation, 2F, PR+PW+EV, FLOAT, false, 0, 100 );  
+  HAPCHAR( SecuritySystemAlarmType, 8E, PR+EV, UINT8, true, 0, 1 );  
+  HAPCHAR( SecuritySystemCurrentState, 66, PR+EV, UINT8, true, 0, 4 );  
+  HAPCHAR( SecuritySystemTargetState, 67, PW+PR+EV, UINT8, true, 0, 3 );  
+  HAPCHAR( SerialNumber, 30, PR, STRING, true, 0, 1 );
+  HAPCHAR( ServiceLabelIndex, CB, PR, UINT8, true, 1, 255 );
+  HAPCHAR( ServiceLabelNamespace, CD, PR, UINT8, true, 0, 1 );
+  HAPCHAR( SlatType, C0, PR, UINT8, true, 0, 1 );
+  HAPCHAR( SleepDiscoveryMode, E8, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( SmokeDetected, 76, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( StatusActive, 75, PR+EV, BOOL, true, 0, 1 );
+  HAPCHAR( StatusFault, 77, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( StatusJammed, 78, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( StatusLowBattery, 79, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( StatusTampered, 7A, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( SulphurDioxideDensity, C5, PR+EV, FLOAT, false, 0, 1000 );
+  HAPCHAR( SwingMode, B6, PR+EV+PW, UINT8, true, 0, 1 );
+  HAPCHAR( TargetAirPurifierState, A8, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( TargetFanState, BF, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( TargetTiltAngle, C2, PW+PR+EV, INT, false, -90, 90 );
+  HAPCHAR( TargetHeaterCoolerState, B2, PW+PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( SetDuration, D3, PW+PR+EV, UINT32, false, 0, 3600 );
+  HAPCHAR( TargetHorizontalTiltAngle, 7B, PW+PR+EV, INT, false, -90, 90 );
+  HAPCHAR( TargetHumidifierDehumidifierState, B4, PW+PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( TargetPosition, 7C, PW+PR+EV, UINT8, false, 0, 100 );
+  HAPCHAR( TargetDoorState, 32, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( TargetHeatingCoolingState, 33, PW+PR+EV, UINT8, true, 0, 3 );
+  HAPCHAR( TargetMediaState, 137, PW+PR+EV, UINT8, true, 0, 2 );
+  HAPCHAR( TargetRelativeHumidity, 34, PW+PR+EV, FLOAT, false, 0, 100 );
+  HAPCHAR( TargetTemperature, 35, PW+PR+EV, FLOAT, false, 10, 38 );
+  HAPCHAR( TargetVisibilityState, 134, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( TemperatureDisplayUnits, 36, PW+PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( TargetVerticalTiltAngle, 7D, PW+PR+EV, INT, false, -90, 90 );
+  HAPCHAR( ValveType, D5, PR+EV, UINT8, true, 0, 3 );  
+  HAPCHAR( Version, 37, PR, STRING, true, 0, 1 );
+  HAPCHAR( VOCDensity, C8, PR+EV, FLOAT, false, 0, 1000 );   
+  HAPCHAR( Volume, 119, PW+PR+EV, UINT8, false, 0, 100 );
+  HAPCHAR( VolumeControlType, E9, PR+EV, UINT8, true, 0, 3 );
+  HAPCHAR( VolumeSelector, EA, PR+EV, UINT8, true, 0, 1 );
+  HAPCHAR( WaterLevel, B5, PR+EV, FLOAT, false, 0, 100 );
+
+  enum {N_CHARS=__COUNTER__-FIRST_INDEX-1};     // total number of Characteristics defined above
+
+  const HapChar *get(int index) const {return(index>=0 && index<N_CHARS?(const HapChar *)this+index:NULL);}      // returns HapChar with specified index (or NULL if out of range)
+  int indexOf(const HapChar *h) const {return(get(h->index)==h?h->index:HapChar::CUSTOM);}                            // returns index of HapChar h (or CUSTOM if h is not part of this table)
+};
+
+static_assert(sizeof(HapCharacteristics)==HapCharacteristics::N_CHARS*sizeof(HapChar),"HapCharacteristics must contain nothing but HAPCHAR() entries");
+
+extern const HapCharacteristics hapChars;       // const so that the entire table is placed in flash rather than RAM
+
+///////////////////////////////
+
+struct HapMask {                // 128-bit set of Characteristics, indexed by HapChar::index
+
+  uint64_t bits[2];
 
+  constexpr HapMask set(int i) const {return(i<64?HapMask{{bits[0]|(1ULL<<i),bits[1]}}:HapMask{{bits[0],bits[1]|(1ULL<<(i-64))}});}     // returns copy of mask with bit i set
+  constexpr boolean test(int i) const {return((bits[i>>6]>>(i&63))&1);}                                                                   // returns true if bit i is set
+  constexpr HapMask without(const HapMask &m) const {return(HapMask{{bits[0]&~m.bits[0],bits[1]&~m.bits[1]}});}                        // returns copy of mask with all bits in m cleared
+  constexpr boolean empty() const {return(!(bits[0]|bits[1]));}                                                                          // returns true if no bits are set
 };
 
-extern HapCharacteristics hapChars;
+static_assert(HapCharacteristics::N_CHARS<=128,"HapMask can hold no more than 128 Characteristics");
+
+///////////////////////////////
+
+struct HapSchema {              // sets of required and optional Characteristics for a Service, built with the HAPREQ()/HAPOPT() or REQ()/OPT() macros in Span.h
+
+  HapMask req;
+  HapMask opt;
+
+  constexpr HapSchema addReq(int i) const {return(HapSchema{req.set(i),opt});}
+  constexpr HapSchema addOpt(int i) const {return(HapSchema{req,opt.set(i)});}
+  constexpr boolean allows(int i) const {return(req.test(i) || opt.test(i));}    // returns true if Characteristic with index i is either required or optional
+  constexpr boolean empty() const {return(req.empty() && opt.empty());}          // returns true if no Characteristics are listed, in which case the schema is not checked
+};
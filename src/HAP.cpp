@@ -28,6 +28,8 @@
 #include <ESPmDNS.h>
 #include <sodium.h>
 #include <MD5Builder.h>
+#include <esp_ota_ops.h>
+#include <algorithm>
 
 #include "HAP.h"
 #include "HomeSpan.h"
@@ -121,10 +123,10 @@ void HAPClient::init(){
   // create broadcaset name from server base name plus accessory ID (without ':')
   
   int nChars=snprintf(NULL,0,"%s-%2.2s%2.2s%2.2s%2.2s%2.2s%2.2s",homeSpan.hostNameBase,accessory.ID,accessory.ID+3,accessory.ID+6,accessory.ID+9,accessory.ID+12,accessory.ID+15);       
-  homeSpan.hostName=(char *)malloc(nChars+1);
+  homeSpan.hostName=(char *)HeapTag::malloc(HeapTag::NETWORK,nChars+1);
   sprintf(homeSpan.hostName,"%s-%2.2s%2.2s%2.2s%2.2s%2.2s%2.2s",homeSpan.hostNameBase,accessory.ID,accessory.ID+3,accessory.ID+6,accessory.ID+9,accessory.ID+12,accessory.ID+15);
 
-  tlv8.create(kTLVType_State,1,"STATE");                 // define the actual TLV records needed for the implementation of HAP; one for each kTLVType needed (HAP Table 5-6)
+  tlv8.create(kTLVType_State,1,"STATE");                 // define the actual TLV records needed for the implementation of HAP; one for each kTLVType needed (HAP Table 5-6).  No storage is allocated - maximum lengths are used only to validate records
   tlv8.create(kTLVType_PublicKey,384,"PUBKEY");
   tlv8.create(kTLVType_Method,1,"METHOD");
   tlv8.create(kTLVType_Salt,16,"SALT");
@@ -145,6 +147,30 @@ void HAPClient::init(){
 
   Serial.print("\n");
 
+  checkConfigNumber();
+  homeSpan.buildLoops();
+
+}
+
+//////////////////////////////////////
+
+boolean HAPClient::checkConfigNumber(){
+
+  SpanSnapshot current, stored;
+  size_t len=sizeof(stored);
+
+  memcpy(current.elfHash,esp_ota_get_app_description()->app_elf_sha256,sizeof(current.elfHash));
+  current.fingerprint=homeSpan.fingerprint();
+
+  if(!nvs_get_blob(hapNVS,"HAPSNAP",&stored,&len) && len==sizeof(stored) && !memcmp(&current,&stored,sizeof(stored))){      // same build and same database structure as when hash was last verified
+    Serial.print("Accessory configuration number: ");
+    Serial.print(homeSpan.hapConfig.configNumber);
+    Serial.print(" (database unchanged since last verified)\n\n");
+    return(false);
+  }
+
+  nvs_set_blob(hapNVS,"HAPSNAP",&current,sizeof(current));      // record snapshot (committed below)
+
   uint8_t tHash[48];
   TempBuffer <char> tBuf(homeSpan.sprintfAttributes(NULL)+1);
   homeSpan.sprintfAttributes(tBuf.buf);  
@@ -161,20 +187,15 @@ void HAPClient::init(){
     Serial.print("\n\n");
     nvs_set_blob(hapNVS,"HAPHASH",&homeSpan.hapConfig,sizeof(homeSpan.hapConfig));     // update data
     nvs_commit(hapNVS);                                                                // commit to NVS
-  } else {
-    Serial.print("Accessory configuration number: ");
-    Serial.print(homeSpan.hapConfig.configNumber);
-    Serial.print("\n\n");    
-  }
-
-  for(int i=0;i<homeSpan.Accessories.size();i++){                             // identify all services with over-ridden loop() methods
-    for(int j=0;j<homeSpan.Accessories[i]->Services.size();j++){
-      SpanService *s=homeSpan.Accessories[i]->Services[j];      
-      if((void(*)())(s->*(&SpanService::loop)) != (void(*)())(&SpanService::loop))    // save pointers to services in Loops vector
-        homeSpan.Loops.push_back(s);
-    }
+    return(true);
   }
+  
+  nvs_commit(hapNVS);                                         // commit snapshot to NVS
 
+  Serial.print("Accessory configuration number: ");
+  Serial.print(homeSpan.hapConfig.configNumber);
+  Serial.print("\n\n");    
+  return(false);
 }
 
 //////////////////////////////////////
@@ -182,6 +203,7 @@ void HAPClient::init(){
 void HAPClient::processRequest(){
 
   int nBytes;
+  uint32_t startTime=micros();         // start of request, for recording latency of each route
   
   if(cPair){                           // expecting encrypted message
     LOG2("<<<< #### ");
@@ -211,6 +233,7 @@ void HAPClient::processRequest(){
   } // encrypted/plaintext
       
   httpBuf[nBytes]='\0';         // add null character to enable string functions
+  tlv8.setBuffer(httpBuf+nBytes+1,MAX_HTTP-nBytes);     // use remainder of httpBuf as scratch storage for any TLV records written in response
       
   char *body=(char *)httpBuf;   // char pointer to start of HTTP Body
   char *p;                          // char pointer used for searches
@@ -247,40 +270,46 @@ void HAPClient::processRequest(){
     if(!strncmp(body,"POST /pair-setup ",17) &&                              // POST PAIR-SETUP
        strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
-       if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
+       if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
                
+      homeSpan.Memory.start(SpanMemory::PAIR_SETUP);
       postPairSetupURL();                   // process URL
+      homeSpan.Memory.stop(SpanMemory::PAIR_SETUP);
+      homeSpan.Stats.record(SpanStats::PAIR_SETUP,startTime);
       return;
     }
 
     if(!strncmp(body,"POST /pair-verify ",18) &&                             // POST PAIR-VERIFY
        strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
-       if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
+       if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
                
       postPairVerifyURL();                  // process URL    
+      homeSpan.Stats.record(SpanStats::PAIR_VERIFY,startTime);
       return;
     }
             
     if(!strncmp(body,"POST /pairings ",15) &&                                // POST PAIRINGS
        strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
-       if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
+       if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
                
       postPairingsURL();                  // process URL    
+      homeSpan.Stats.record(SpanStats::PAIRINGS,startTime);
       return;
     }
 
     if(!strncmp(body,"POST /pairings ",15) &&                                // POST PAIRINGS
        strstr(body,"Content-Type: application/pairing+tlv8") &&              // check that content is TLV8
        tlv8.unpack(content,cLen)){                                          // read TLV content
-       if(homeSpan.logLevel>1) tlv8.print();                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
+       if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);                                                        // print TLV records in form "TAG(INT) LENGTH(INT) VALUES(HEX)"
       LOG2("------------ END TLVS! ------------\n");
                
       postPairingsURL();                  // process URL    
+      homeSpan.Stats.record(SpanStats::PAIRINGS,startTime);
       return;
     }
 
@@ -306,6 +335,7 @@ void HAPClient::processRequest(){
       LOG2("\n------------ END JSON! ------------\n");
                
       putCharacteristicsURL((char *)content);                           // process URL
+      homeSpan.Stats.record(SpanStats::PUT_CHARACTERISTICS,startTime);
       return;
     }
 
@@ -317,6 +347,7 @@ void HAPClient::processRequest(){
       LOG2("\n------------ END JSON! ------------\n");
                
       putPrepareURL((char *)content);                           // process URL
+      homeSpan.Stats.record(SpanStats::PUT_PREPARE,startTime);
       return;
     }
       
@@ -329,12 +360,16 @@ void HAPClient::processRequest(){
   if(!strncmp(body,"GET ",4)){                       // this is a GET request
                     
     if(!strncmp(body,"GET /accessories ",17)){       // GET ACCESSORIES
+      homeSpan.Memory.start(SpanMemory::GET_ACCESSORIES);
       getAccessoriesURL();
+      homeSpan.Memory.stop(SpanMemory::GET_ACCESSORIES);
+      homeSpan.Stats.record(SpanStats::GET_ACCESSORIES,startTime);
       return;
     }
 
     if(!strncmp(body,"GET /characteristics?",21)){   // GET CHARACTERISTICS
       getCharacteristicsURL(body+21);
+      homeSpan.Stats.record(SpanStats::GET_CHARACTERISTICS,startTime);
       return;
     }
 
@@ -354,15 +389,16 @@ void HAPClient::processRequest(){
 int HAPClient::notFoundError(){
 
   char s[]="HTTP/1.1 404 Not Found\r\n\r\n";
+  homeSpan.Stats.nNotFound++;
+  LOG_EVENT(HTTP_ERROR,conNum,404,0,0);
   LOG2("\n>>>>>>>>>> ");
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");
   LOG2(s);
-  client.print(s);
+  transmit((uint8_t *)s,strlen(s));         // error response is queued behind any frames still waiting to be sent...
   LOG2("------------ SENT! --------------\n");
   
-  delay(1);
-  client.stop();
+  stopAfterTx();                            // ...and connection is closed only after it has been sent
 
   return(-1);
 }
@@ -372,15 +408,16 @@ int HAPClient::notFoundError(){
 int HAPClient::badRequestError(){
 
   char s[]="HTTP/1.1 400 Bad Request\r\n\r\n";
+  homeSpan.Stats.nBadRequests++;
+  LOG_EVENT(HTTP_ERROR,conNum,400,0,0);
   LOG2("\n>>>>>>>>>> ");
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");
   LOG2(s);
-  client.print(s);
+  transmit((uint8_t *)s,strlen(s));         // error response is queued behind any frames still waiting to be sent...
   LOG2("------------ SENT! --------------\n");
   
-  delay(1);
-  client.stop();
+  stopAfterTx();                            // ...and connection is closed only after it has been sent
 
   return(-1);
 }
@@ -394,11 +431,10 @@ int HAPClient::unauthorizedError(){
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");
   LOG2(s);
-  client.print(s);
+  transmit((uint8_t *)s,strlen(s));         // error response is queued behind any frames still waiting to be sent...
   LOG2("------------ SENT! --------------\n");
   
-  delay(1);
-  client.stop();
+  stopAfterTx();                            // ...and connection is closed only after it has been sent
 
   return(-1);
 }
@@ -551,7 +587,7 @@ int HAPClient::postPairSetupURL(){
         return(0);
       }
 
-      if(homeSpan.logLevel>1) tlv8.print();             // print decrypted TLV data
+      if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);             // print decrypted TLV data
       LOG2("------- END DECRYPTED TLVS! -------\n");
        
       if(!tlv8.buf(kTLVType_Identifier) || !tlv8.buf(kTLVType_PublicKey) || !tlv8.buf(kTLVType_Signature)){            
@@ -631,7 +667,7 @@ int HAPClient::postPairSetupURL(){
 
       LOG2("------- ENCRYPTING SUB-TLVS -------\n");
 
-      if(homeSpan.logLevel>1) tlv8.print();
+      if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);
 
       size_t subTLVLen=tlv8.pack(NULL);                 // get size of buffer needed to store sub-TLV 
       uint8_t subTLV[subTLVLen];
@@ -643,7 +679,7 @@ int HAPClient::postPairSetupURL(){
       
       unsigned long long edLen;
 
-      crypto_aead_chacha20poly1305_ietf_encrypt(tlv8.buf(kTLVType_EncryptedData),&edLen,subTLV,subTLVLen,NULL,0,NULL,(unsigned char *)"\x00\x00\x00\x00PS-Msg06",sessionKey);
+      crypto_aead_chacha20poly1305_ietf_encrypt(tlv8.buf(kTLVType_EncryptedData,subTLVLen+16),&edLen,subTLV,subTLVLen,NULL,0,NULL,(unsigned char *)"\x00\x00\x00\x00PS-Msg06",sessionKey);   // reserve room for sub-TLV plus 16-byte Authentication Tag
                                               
       LOG2("---------- END SUB-TLVS! ----------\n");
 
@@ -739,7 +775,7 @@ int HAPClient::postPairVerifyURL(){
 
         LOG2("------- ENCRYPTING SUB-TLVS -------\n");
 
-        if(homeSpan.logLevel>1) tlv8.print();
+        if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);
 
         size_t subTLVLen=tlv8.pack(NULL);                 // get size of buffer needed to store sub-TLV 
         uint8_t subTLV[subTLVLen];
@@ -753,7 +789,7 @@ int HAPClient::postPairVerifyURL(){
 
         hkdf.create(sessionKey,sharedCurveKey,32,"Pair-Verify-Encrypt-Salt","Pair-Verify-Encrypt-Info");       // create SessionKey (32 bytes)
 
-        crypto_aead_chacha20poly1305_ietf_encrypt(tlv8.buf(kTLVType_EncryptedData),&edLen,subTLV,subTLVLen,NULL,0,NULL,(unsigned char *)"\x00\x00\x00\x00PV-Msg02",sessionKey);
+        crypto_aead_chacha20poly1305_ietf_encrypt(tlv8.buf(kTLVType_EncryptedData,subTLVLen+16),&edLen,subTLV,subTLVLen,NULL,0,NULL,(unsigned char *)"\x00\x00\x00\x00PV-Msg02",sessionKey);   // reserve room for sub-TLV plus 16-byte Authentication Tag
                                               
         LOG2("---------- END SUB-TLVS! ----------\n");
         
@@ -803,7 +839,7 @@ int HAPClient::postPairVerifyURL(){
         return(0);
       }
 
-      if(homeSpan.logLevel>1) tlv8.print();             // print decrypted TLV data
+      if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);             // print decrypted TLV data
       LOG2("------- END DECRYPTED TLVS! -------\n");
 
       if(!tlv8.buf(kTLVType_Identifier) || !tlv8.buf(kTLVType_Signature)){            
@@ -1022,13 +1058,13 @@ int HAPClient::postPairingsURL(){
   // must be performed AFTER sending the TLV response, since that connection itself may be terminated below
 
   for(int i=0;i<homeSpan.maxConnections;i++){     // loop over all connection slots
-    if(hap[i]->client){                    // if slot is connected
+    if(hap[i] && hap[i]->client){          // if slot is connected
       
       if(!nAdminControllers() || (hap[i]->cPair && !hap[i]->cPair->allocated)){    // accessory unpaired, OR client connection is verified but points to a newly *unallocated* controller
         LOG1("*** Terminating Client #");
         LOG1(i);
         LOG1("\n");
-        hap[i]->client.stop();
+        hap[i]->stopAfterTx();             // close only after any queued data, including the TLV response above, has been sent
       }
       
     } // if client connected
@@ -1204,8 +1240,8 @@ int HAPClient::putPrepareURL(char *json){
   char pidToken[]="\"pid\":";
   
   char *cBuf;
-  uint32_t ttl;
-  uint64_t pid;
+  uint32_t ttl=0;
+  uint64_t pid=0;
    
   if((cBuf=strstr(json,ttlToken)))
     sscanf(cBuf+strlen(ttlToken),"%u",&ttl);
@@ -1217,7 +1253,7 @@ int HAPClient::putPrepareURL(char *json){
   StatusCode status=StatusCode::OK;
 
   if(ttl>0 && pid>0){                           // found required elements
-    homeSpan.TimedWrites[pid]=ttl+millis();     // store this pid/alarmTime combination 
+    homeSpan.TimedWrites.add(pid,ttl+millis()); // store this pid/alarmTime combination (replaces PID closest to expiring if already at capacity)
   } else {                                      // problems parsing request
     status=StatusCode::InvalidValue;
   }
@@ -1246,8 +1282,12 @@ void HAPClient::callServiceLoops(){
 
   homeSpan.snapTime=millis();                     // snap the current time for use in ALL loop routines
   
-  for(int i=0;i<homeSpan.Loops.size();i++)        // loop over all services with over-ridden loop() methods
-    homeSpan.Loops[i]->loop();                    // call the loop() method
+  for(int i=0;i<homeSpan.Loops.size();i++){       // loop over all services with over-ridden loop() methods
+    SpanService *s=homeSpan.Loops[i];
+    uint32_t startTime=micros();
+    s->loop();                                    // call the loop() method
+    homeSpan.timeCallback(s,"loop",startTime);
+  }
 }
 
 
@@ -1258,7 +1298,9 @@ void HAPClient::checkPushButtons(){
   for(int i=0;i<homeSpan.PushButtons.size();i++){                                // loop over all defined pushbuttons
     SpanButton *sb=homeSpan.PushButtons[i];                                      // temporary pointer to SpanButton
     if(sb->pushButton->triggered(sb->singleTime,sb->longTime,sb->doubleTime)){   // if the underlying PushButton is triggered
+      uint32_t startTime=micros();
       sb->service->button(sb->pin,sb->pushButton->type());                       // call the Service's button() routine with pin and type as parameters
+      homeSpan.timeCallback(sb->service,"button",startTime);
     }
   }
     
@@ -1278,16 +1320,12 @@ void HAPClient::checkNotifications(){
 
 void  HAPClient::checkTimedWrites(){
 
-  unsigned long cTime=millis();                                       // get current time
+  int n=homeSpan.TimedWrites.expire(millis());        // remove any expired Timed Write PIDs
 
-  char c[64];
-  
-  for(auto tw=homeSpan.TimedWrites.begin(); tw!=homeSpan.TimedWrites.end(); tw++){      // loop over all Timed Writes using an iterator
-    if(cTime>tw->second){                                                               // timer has expired
-       sprintf(c,"Removing PID=%llu  ALARM=%u\n",tw->first,tw->second);
-       LOG2(c);
-       homeSpan.TimedWrites.erase(tw);
-      }
+  if(n){
+    LOG2("Removed ");
+    LOG2(n);
+    LOG2(" expired Timed Write PID(s)\n");
   }
 }
 
@@ -1295,9 +1333,12 @@ void  HAPClient::checkTimedWrites(){
 
 
 void HAPClient::eventNotify(SpanBuf *pObj, int nObj, int ignoreClient){
+
+  uint32_t startTime=micros();
+  int nSent=0;
   
   for(int cNum=0;cNum<homeSpan.maxConnections;cNum++){        // loop over all connection slots
-    if(hap[cNum]->client && cNum!=ignoreClient){       // if there is a client connected to this slot and it is NOT flagged to be ignored (in cases where it is the client making a PUT request)
+    if(hap[cNum] && hap[cNum]->client && !hap[cNum]->stopPending && cNum!=ignoreClient){       // if there is a client connected to this slot and it is NOT flagged to be ignored (in cases where it is the client making a PUT request)
 
       int nBytes=homeSpan.sprintfNotify(pObj,nObj,NULL,cNum);          // get JSON response for notifications to client cNum - includes terminating null (will be recast to uint8_t* below)
 
@@ -1316,12 +1357,156 @@ void HAPClient::eventNotify(SpanBuf *pObj, int nObj, int ignoreClient){
         LOG2(jsonBuf);
         LOG2("\n");
   
-        hap[cNum]->sendEncrypted(body,(uint8_t *)jsonBuf,nBytes);        // note recasting of jsonBuf into uint8_t*
+        hap[cNum]->sendEncrypted(body,(uint8_t *)jsonBuf,nBytes,true);   // note recasting of jsonBuf into uint8_t*
+        hap[cNum]->nEvents++;
+        nSent++;
 
       } // if there are characteristic updates to notify client cNum
     } // if client exists
   }
 
+  if(nSent){                                          // record fan-out time only if at least one client was notified
+    homeSpan.Stats.nEvents+=nSent;
+    homeSpan.Stats.record(SpanStats::EVENT_NOTIFY,startTime);
+  }
+
+}
+
+//////////////////////////////////////
+
+void HAPClient::transmit(uint8_t *buf, int len, boolean isEvent){
+
+  struct iovec iov;
+  iov.iov_base=buf;
+  iov.iov_len=len;
+  transmit(&iov,1,isEvent);
+}
+
+//////////////////////////////////////
+
+void HAPClient::transmit(struct iovec *iov, int iovcnt, boolean isEvent){
+
+  int len=0;
+  int n=0;
+
+  for(int i=0;i<iovcnt;i++)
+    len+=iov[i].iov_len;
+
+  homeSpan.Stats.nBytesSent+=len;
+
+  if(!txLen){                                           // nothing already queued - try to send immediately, gathering all pieces into a single write
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov=iov;
+    msg.msg_iovlen=iovcnt;
+    
+    n=sendmsg(client.fd(),&msg,MSG_DONTWAIT);
+    
+    if(n<0){
+      if(errno!=EAGAIN && errno!=EWOULDBLOCK){          // write failed - client is likely no longer reachable
+        nWasted++;
+        return;
+      }
+      n=0;
+    }
+
+    if(n==len)                                          // everything sent
+      return;
+      
+  } else
+  
+  if(isEvent && txLen-std::max(txSent,txReplyEnd)+len>MAX_TX_QUEUE){     // client has not kept up with prior Event Notifications - encrypted frames cannot be dropped (nonces must stay in sequence) so disconnect instead
+    LOG1("** Client ");
+    LOG1(client.remoteIP());
+    LOG1(" is not reading data fast enough.  Disconnecting.\n");
+    LOG_EVENT(SLOW_CONSUMER,0xFF,client.fd(),txLen-txSent,0);
+    nWasted++;
+    clearTx();
+    client.stop();
+    return;
+  }
+
+  if(txSent){                                           // reclaim bytes already sent by moving unsent bytes to front of queue
+    memmove(txBuf,txBuf+txSent,txLen-txSent);
+    txLen-=txSent;
+    txReplyEnd=std::max(txReplyEnd-txSent,0);
+    txSent=0;
+  }
+
+  uint8_t *newBuf=(uint8_t *)HeapTag::realloc(HeapTag::TX_QUEUE,txBuf,txLen+len-n);     // append unsent bytes to queue
+  
+  if(!newBuf){
+    Serial.print("\n*** ERROR:  Can't allocate memory to queue data for client.  Disconnecting.\n\n");
+    clearTx();
+    client.stop();
+    return;
+  }
+
+  txBuf=newBuf;
+
+  for(int i=0;i<iovcnt;i++){                            // copy unsent portion of each piece into queue
+    int iLen=iov[i].iov_len;
+    if(n>=iLen){                                        // this piece was fully sent
+      n-=iLen;
+      continue;
+    }
+    memcpy(txBuf+txLen,(uint8_t *)iov[i].iov_base+n,iLen-n);
+    txLen+=iLen-n;
+    n=0;
+  }
+
+  if(!isEvent)                                          // replies to the client's own requests are never counted against MAX_TX_QUEUE
+    txReplyEnd=txLen;
+}
+
+//////////////////////////////////////
+
+void HAPClient::drainTx(){
+
+  if(!txLen)
+    return;
+
+  if(!client){                                          // client has disconnected
+    clearTx();
+    return;
+  }
+
+  int n=send(client.fd(),txBuf+txSent,txLen-txSent,MSG_DONTWAIT);
+
+  if(n<0){
+    if(errno!=EAGAIN && errno!=EWOULDBLOCK){            // write failed - client is likely no longer reachable
+      nWasted++;
+      clearTx();
+    }
+  } else {
+    txSent+=n;
+    if(txSent==txLen)                                   // queue is empty
+      clearTx();
+  }
+
+  if(!txLen && stopPending)                             // last queued bytes have been sent (or can no longer be sent) - close connection as requested
+    client.stop();
+}
+
+//////////////////////////////////////
+
+void HAPClient::stopAfterTx(){
+
+  if(txLen)
+    stopPending=true;
+  else
+    client.stop();
+}
+
+//////////////////////////////////////
+
+void HAPClient::clearTx(){
+
+  HeapTag::free(HeapTag::TX_QUEUE,txBuf);
+  txBuf=NULL;
+  txLen=0;
+  txSent=0;
+  txReplyEnd=0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -1341,11 +1526,15 @@ void HAPClient::tlvRespond(){
   LOG2(client.remoteIP());
   LOG2(" >>>>>>>>>>\n");
   LOG2(body);
-  if(homeSpan.logLevel>1) tlv8.print();
+  if(LOG_ON(2)) tlv8.print(*homeSpan.logOut);
 
   if(!cPair){                       // unverified, unencrypted session
-    client.print(body);
-    client.write(tlvData,nBytes);      
+    struct iovec iov[2];
+    iov[0].iov_base=body;
+    iov[0].iov_len=nChars;
+    iov[1].iov_base=tlvData;
+    iov[1].iov_len=nBytes;
+    transmit(iov,2);                // send header and TLV data together in a single write
     LOG2("------------ SENT! --------------\n");
   } else {
     sendEncrypted(body,tlvData,nBytes);
@@ -1391,7 +1580,7 @@ int HAPClient::receiveEncrypted(){
 
 //////////////////////////////////////
 
-void HAPClient::sendEncrypted(char *body, uint8_t *dataBuf, int dataLen){
+void HAPClient::sendEncrypted(char *body, uint8_t *dataBuf, int dataLen, boolean isEvent){
 
   const int FRAME_SIZE=1024;          // number of bytes to use in each ChaCha20-Poly1305 encrypted frame when sending encrypted JSON content to Client
   
@@ -1434,7 +1623,7 @@ void HAPClient::sendEncrypted(char *body, uint8_t *dataBuf, int dataLen){
     count+=2+n+16;             // increment count by 2-byte AAD record + length of JSON + 16-byte authentication tag
   }
  
-  client.write(tBuf.buf,count);   // transmit all encrypted frames to Client
+  transmit(tBuf.buf,count,isEvent);       // transmit all encrypted frames to Client (without blocking)
 
   LOG2("-------- SENT ENCRYPTED! --------\n");
       
@@ -1443,40 +1632,35 @@ void HAPClient::sendEncrypted(char *body, uint8_t *dataBuf, int dataLen){
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 
-void HAPClient::hexPrintColumn(uint8_t *buf, int n){
+void HAPClient::hexPrintColumn(uint8_t *buf, int n, Print &out){
 
   char c[16];
   
   for(int i=0;i<n;i++){
     sprintf(c,"%d) %02X",i,buf[i]);
-    Serial.println(c);
+    out.println(c);
   }
 
 }
 
 //////////////////////////////////////
 
-void HAPClient::hexPrintRow(uint8_t *buf, int n){
+void HAPClient::hexPrintRow(uint8_t *buf, int n, Print &out){
 
   char c[16];
   
   for(int i=0;i<n;i++){
     sprintf(c,"%02X",buf[i]);
-    Serial.print(c);
+    out.print(c);
   }
 
 }
 
 //////////////////////////////////////
 
-void HAPClient::charPrintRow(uint8_t *buf, int n){
+void HAPClient::charPrintRow(uint8_t *buf, int n, Print &out){
 
-  char c[16];
-  
-  for(int i=0;i<n;i++){
-    sprintf(c,"%c",buf[i]);
-    Serial.print(c);
-  }
+  out.write(buf,n);
 
 }
 
@@ -1488,8 +1672,8 @@ Controller *HAPClient::findController(uint8_t *id){
     
     if(controllers[i].allocated && !memcmp(controllers[i].ID,id,36)){     // found matching ID
       LOG2("Found Controller: ");
-      if(homeSpan.logLevel>1)
-        charPrintRow(id,36);
+      if(LOG_ON(2))
+        charPrintRow(id,36,*homeSpan.logOut);
       LOG2(controllers[i].admin?" (admin)\n":" (regular)\n");    
       return(controllers+i);                                              // return with pointer to matching controller
     }
@@ -1521,8 +1705,8 @@ Controller *HAPClient::addController(uint8_t *id, uint8_t *ltpk, boolean admin){
     memcpy(slot->LTPK,ltpk,32);
     slot->admin=admin;
     LOG2("\n*** Updated Controller: ");
-    if(homeSpan.logLevel>1)
-      charPrintRow(id,36);
+    if(LOG_ON(2))
+      charPrintRow(id,36,*homeSpan.logOut);
     LOG2(slot->admin?" (admin)\n\n":" (regular)\n\n");
     return(slot);    
   }
@@ -1533,8 +1717,8 @@ Controller *HAPClient::addController(uint8_t *id, uint8_t *ltpk, boolean admin){
     memcpy(slot->LTPK,ltpk,32);
     slot->admin=admin;
     LOG2("\n*** Added Controller: ");
-    if(homeSpan.logLevel>1)
-      charPrintRow(id,36);
+    if(LOG_ON(2))
+      charPrintRow(id,36,*homeSpan.logOut);
     LOG2(slot->admin?" (admin)\n\n":" (regular)\n\n");
     return(slot);       
   }
@@ -1574,8 +1758,8 @@ void HAPClient::removeController(uint8_t *id){
 
   if((slot=findController(id))){      // remove controller if found
     LOG2("\n***Removed Controller: ");
-    if(homeSpan.logLevel>1)
-      charPrintRow(id,36);
+    if(LOG_ON(2))
+      charPrintRow(id,36,*homeSpan.logOut);
     LOG2(slot->admin?" (admin)\n":" (regular)\n");
     slot->allocated=false;
 
@@ -1655,4 +1839,5 @@ Accessory HAPClient::accessory;
 Controller HAPClient::controllers[MAX_CONTROLLERS];    
 SRP6A HAPClient::srp;
 int HAPClient::conNum;
+uint32_t HAPClient::totalWasted=0;
  
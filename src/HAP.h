@@ -28,6 +28,7 @@
 #pragma once
 
 #include <WiFi.h>
+#include <lwip/sockets.h>
 
 #include "HomeSpan.h"
 #include "TLV.h"
@@ -75,24 +76,35 @@ struct HAPClient {
 
   static const int MAX_HTTP=8095;                     // max number of bytes in HTTP message buffer
   static const int MAX_CONTROLLERS=16;                // maximum number of paired controllers (HAP requires at least 16)
-  static const int MAX_ACCESSORIES=41;                // maximum number of allowed Acessories (HAP limit=150, but not enough memory in ESP32 to run that many)
+  static const int MAX_ACCESSORIES=150;               // maximum number of allowed Acessories (HAP limit) - the number that fit in memory is estimated by homeSpan.Budget, which warns at start-up and limits Accessories added later
   
   static TLV<kTLVType,10> tlv8;                       // TLV8 structure (HAP Section 14.1) with space for 10 TLV records of type kTLVType (HAP Table 5-6)
   static nvs_handle hapNVS;                           // handle for non-volatile-storage of HAP data
   static nvs_handle srpNVS;                           // handle for non-volatile-storage of SRP data
   static nvs_handle otaNVS;                           // handle for non-volatile-storage of OTA data
-  static uint8_t httpBuf[MAX_HTTP+1];                 // buffer to store HTTP messages (+1 to leave room for storing an extra 'overflow' character)
+  static uint8_t httpBuf[MAX_HTTP+1];                 // buffer to store HTTP messages (+1 to leave room for storing an extra 'overflow' character); unused remainder also stores TLV records written in response
   static HKDF hkdf;                                   // generates (and stores) HKDF-SHA-512 32-byte keys derived from an inputKey of arbitrary length, a salt string, and an info string
   static pairState pairStatus;                        // tracks pair-setup status
   static SRP6A srp;                                   // stores all SRP-6A keys used for Pair-Setup
   static Accessory accessory;                         // Accessory ID and Ed25519 public and secret keys- permanently stored
   static Controller controllers[MAX_CONTROLLERS];     // Paired Controller IDs and ED25519 long-term public keys - permanently stored
   static int conNum;                                  // connection number - used to keep track of per-connection EV notifications
+  static const int MAX_TX_QUEUE=8192;                 // maximum number of encrypted Event Notification bytes that can be waiting to be sent to a client (beyond any queued replies to its own requests) before it is considered a slow consumer and disconnected
+  static uint32_t totalWasted;                        // cumulative number of writes wasted on connections that have since been closed
 
   // individual structures and data defined for each Hap Client connection
   
   WiFiClient client=0;            // handle to client
   Controller *cPair;              // pointer to info on current, session-verified Paired Controller (NULL=un-verified, and therefore un-encrypted, connection)
+  unsigned long lastActivity=0;   // time (in millis) this connection was established or last received a request from its client
+  uint32_t nEvents=0;             // number of Event Notifications sent since client last sent a request
+  uint32_t nWasted=0;             // number of writes wasted on this connection (failed writes plus Event Notifications outstanding when an idle connection is reaped)
+
+  uint8_t *txBuf=NULL;            // queue of encrypted bytes waiting to be sent to client (NULL if empty)
+  int txLen=0;                    // number of bytes in txBuf
+  int txSent=0;                   // number of bytes in txBuf already sent
+  int txReplyEnd=0;               // number of bytes at start of txBuf that belong to replies to the client's own requests (exempt from MAX_TX_QUEUE)
+  boolean stopPending=false;      // set by stopAfterTx() - connection is closed as soon as txBuf is empty, and no further requests are read from client
    
   // These keys are generated in the first call to pair-verify and used in the second call to pair-verify so must persist for a short period
     
@@ -120,8 +132,16 @@ struct HAPClient {
   int putPrepareURL(char *json);               // PUT /prepare (HAP Section 6.7.2.4)
 
   void tlvRespond();                                                // respond to client with HTTP OK header and all defined TLV data records (those with length>0)
-  void sendEncrypted(char *body, uint8_t *dataBuf, int dataLen);    // send client complete ChaCha20-Poly1305 encrypted HTTP mesage comprising a null-terminated 'body' and 'dataBuf' with 'dataLen' bytes
+  void sendEncrypted(char *body, uint8_t *dataBuf, int dataLen, boolean isEvent=false);    // send client complete ChaCha20-Poly1305 encrypted HTTP mesage comprising a null-terminated 'body' and 'dataBuf' with 'dataLen' bytes (isEvent=true for Event Notifications)
   int receiveEncrypted();                                           // decrypt HTTP request (HAP Section 6.5)
+  void transmit(uint8_t *buf, int len, boolean isEvent=false);                             // sends 'len' bytes of 'buf' to client without blocking, queueing any bytes that cannot be sent immediately (only Event Notifications count against MAX_TX_QUEUE)
+  void transmit(struct iovec *iov, int iovcnt, boolean isEvent=false);                     // same as above, but gathers 'iovcnt' separate pieces into a single write
+  void drainTx();                                                   // sends as many queued bytes as possible without blocking, and frees queue once empty
+  void clearTx();                                                   // discards any queued bytes
+  void stopAfterTx();                                               // closes connection once all queued bytes have been sent (immediately if nothing is queued)
+
+  void *operator new(size_t size){return(HeapTag::newObject(HeapTag::HAP_SLOTS,size));}      // track allocations as part of the HAP connection slots
+  void operator delete(void *p){HeapTag::free(HeapTag::HAP_SLOTS,p);}
 
   int notFoundError();           // return 404 error
   int badRequestError();         // return 400 error
@@ -130,10 +150,11 @@ struct HAPClient {
   // define static methods
     
   static void init();                                  // initialize HAP after start-up
+  static boolean checkConfigNumber();                  // hashes HAP database and, if hash has changed, increments and saves configuration number; returns true if changed
     
-  static void hexPrintColumn(uint8_t *buf, int n);     // prints 'n' bytes of *buf as HEX, one byte per row.  For diagnostics/debugging only
-  static void hexPrintRow(uint8_t *buf, int n);        // prints 'n' bytes of *buf as HEX, all on one row
-  static void charPrintRow(uint8_t *buf, int n);       // prints 'n' bytes of *buf as CHAR, all on one row
+  static void hexPrintColumn(uint8_t *buf, int n, Print &out=Serial);     // prints 'n' bytes of *buf as HEX, one byte per row, to 'out'.  For diagnostics/debugging only
+  static void hexPrintRow(uint8_t *buf, int n, Print &out=Serial);        // prints 'n' bytes of *buf as HEX, all on one row, to 'out'
+  static void charPrintRow(uint8_t *buf, int n, Print &out=Serial);       // prints 'n' bytes of *buf as CHAR, all on one row, to 'out'
   
   static Controller *findController(uint8_t *id);                                      // returns pointer to controller with mathching ID (or NULL if no match)
   static Controller *getFreeController();                                              // return pointer to next free controller slot (or NULL if no free slots)
@@ -31,6 +31,14 @@
 #include <WiFi.h>
 #include <ArduinoOTA.h>
 #include <esp_ota_ops.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <lwip/sockets.h>
+#include <algorithm>
+
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+  #include <esp_pm.h>
+#endif
 
 #include "HomeSpan.h"
 #include "HAP.h"
@@ -39,7 +47,7 @@ using namespace Utils;
 
 HAPClient **hap;                    // HAP Client structure containing HTTP client connections, parsing routines, and state variables (global-scoped variable)
 Span homeSpan;                      // HAP Attributes database and all related control functions for this Accessory (global-scoped variable)
-HapCharacteristics hapChars;        // Instantiation of all HAP Characteristics (used to create SpanCharacteristics)
+const HapCharacteristics hapChars;  // Instantiation of all HAP Characteristics (used to create SpanCharacteristics)
 
 ///////////////////////////////
 //         Span              //
@@ -56,12 +64,25 @@ void Span::begin(Category catID, const char *displayName, const char *hostNameBa
   statusLED.init(statusPin);
 
   int maxLimit=CONFIG_LWIP_MAX_SOCKETS-2-otaEnabled;
+  if(maxLimit>MAX_CONNECTIONS)
+    maxLimit=MAX_CONNECTIONS;
   if(maxConnections>maxLimit)
     maxConnections=maxLimit;
 
-  hap=(HAPClient **)calloc(maxConnections,sizeof(HAPClient *));
-  for(int i=0;i<maxConnections;i++)
-    hap[i]=new HAPClient;
+  #if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    if(pollTimeout){                                      // allow automatic light-sleep while poll() is blocked waiting for new activity
+      esp_pm_config_esp32_t pmConfig;
+      pmConfig.max_freq_mhz=CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+      pmConfig.min_freq_mhz=40;                         // XTAL frequency
+      pmConfig.light_sleep_enable=true;
+      esp_pm_configure(&pmConfig);
+    }
+  #endif
+
+  hap=(HAPClient **)HeapTag::calloc(HeapTag::HAP_SLOTS,maxConnections,sizeof(HAPClient *));     // slots are empty (NULL) until a client connects
+
+  if(logBufferSize && logBuffer.begin(logBufferSize,logBufferDrop))  // log messages are written to serial monitor in the background
+    logOut=&logBuffer;
 
   hapServer=new WiFiServer(tcpPortNum);
 
@@ -89,6 +110,11 @@ void Span::begin(Category catID, const char *displayName, const char *hostNameBa
 
   Serial.print("Message Logs:     Level ");
   Serial.print(logLevel);  
+  if(logOut==&logBuffer){
+    Serial.print(" (");
+    Serial.print(logBufferSize);
+    Serial.print("-byte buffer)");
+  }
   Serial.print("\nStatus LED:       Pin ");
   Serial.print(statusPin);  
   Serial.print("\nDevice Control:   Pin ");
@@ -129,31 +155,25 @@ void Span::poll() {
 
   if(!isInitialized){
   
-    if(!homeSpan.Accessories.empty()){
-      
-      if(!homeSpan.Accessories.back()->Services.empty())
-        homeSpan.Accessories.back()->Services.back()->validate();    
-        
+    if(!homeSpan.Accessories.empty())
       homeSpan.Accessories.back()->validate();    
-    }
 
-    if(nWarnings>0){
-      configLog+="\n*** CAUTION: There " + String((nWarnings>1?"are ":"is ")) + String(nWarnings) + " WARNING" + (nWarnings>1?"S":"") + " associated with this configuration that may lead to the device becoming non-responsive, or operating in an unexpected manner. ***\n";
-    }
+    readyTime=millis();
+    readyHeap=ESP.getFreeHeap();
+    readyMinHeap=ESP.getMinFreeHeap();
+
+    Budget.compute();
+    if(!Budget.fits())
+      nWarnings++;
 
     processSerialCommand("i");        // print homeSpan configuration info
-   
-    if(nFatalErrors>0){
-      Serial.print("\n*** PROGRAM HALTED DUE TO ");
-      Serial.print(nFatalErrors);
-      Serial.print(" FATAL ERROR");
-      if(nFatalErrors>1)
-        Serial.print("S");
-      Serial.print(" IN CONFIGURATION! ***\n\n");
-      while(1);
-    }    
+    checkFatalErrors();
+
+    vector<SpanConfigRecord>().swap(configLog);     // configuration records are no longer needed (printConfig() re-creates them from the database) - swap releases their memory
 
     Serial.print("\n");
+
+    buildIndex();             // index all Characteristics for fast lookup by aid/iid
         
     HAPClient::init();        // read NVS and load HAP settings  
 
@@ -182,12 +202,10 @@ void Span::poll() {
       checkConnect();
   }
 
-  char cBuf[17]="?";
+  char *cBuf;
   
-  if(Serial.available()){
-    readSerial(cBuf,16);
-    processSerialCommand(cBuf);
-  }
+  if((cBuf=serialLine.read()))                  // a complete command has been typed
+    processSerialCommand(strlen(cBuf)?cBuf:"?");  // an empty line displays the help menu
 
   WiFiClient newClient;
 
@@ -195,7 +213,7 @@ void Span::poll() {
     int freeSlot=getFreeSlot();                                // get next free slot
 
     if(freeSlot==-1){                                          // no available free slots
-      freeSlot=randombytes_uniform(maxConnections);
+      freeSlot=getEvictSlot();
       LOG2("=======================================\n");
       LOG1("** Freeing Client #");
       LOG1(freeSlot);
@@ -203,11 +221,34 @@ void Span::poll() {
       LOG1(millis()/1000);
       LOG1(" sec) ");
       LOG1(hap[freeSlot]->client.remoteIP());
-      LOG1("\n");
+      LOG1(hap[freeSlot]->cPair?" verified":" unverified");
+      LOG1(", idle ");
+      LOG1((millis()-hap[freeSlot]->lastActivity)/1000);
+      LOG1(" sec\n");
+      LOG_EVENT(EVICT,freeSlot,0,(millis()-hap[freeSlot]->lastActivity)/1000,0);
       hap[freeSlot]->client.stop();                     // disconnect client from first slot and re-use
     }
 
+    if(!hap[freeSlot])                           // slot is empty - allocate connection state only now that it is needed
+      hap[freeSlot]=new HAPClient;
+
     hap[freeSlot]->client=newClient;             // copy new client handle into free slot
+    LOG_EVENT(CONNECT,freeSlot,0,(uint32_t)newClient.remoteIP(),0);
+
+    int noDelay=1;                               // all messages are written in one piece, so there is no benefit to delaying small segments (Nagle)
+    setsockopt(newClient.fd(),IPPROTO_TCP,TCP_NODELAY,&noDelay,sizeof(noDelay));
+
+    if(keepAliveIdle){                           // enable TCP keepalive so that half-open connections (e.g. controllers that left the network) are detected and dropped
+      int fd=newClient.fd();
+      int enable=1;
+      int idle=keepAliveIdle;
+      int interval=keepAliveInterval;
+      int count=keepAliveCount;
+      setsockopt(fd,SOL_SOCKET,SO_KEEPALIVE,&enable,sizeof(enable));
+      setsockopt(fd,IPPROTO_TCP,TCP_KEEPIDLE,&idle,sizeof(idle));
+      setsockopt(fd,IPPROTO_TCP,TCP_KEEPINTVL,&interval,sizeof(interval));
+      setsockopt(fd,IPPROTO_TCP,TCP_KEEPCNT,&count,sizeof(count));
+    }
 
     LOG2("=======================================\n");
     LOG1("** Client #");
@@ -224,15 +265,47 @@ void Span::poll() {
     LOG2("\n");
 
     hap[freeSlot]->cPair=NULL;                   // reset pointer to verified ID
+    hap[freeSlot]->lastActivity=millis();       // start tracking activity of this connection
+    hap[freeSlot]->nEvents=0;
+    hap[freeSlot]->clearTx();                   // discard any data still queued for prior client in this slot
+    hap[freeSlot]->stopPending=false;
     homeSpan.clearNotify(freeSlot);             // clear all notification requests for this connection
     HAPClient::pairStatus=pairState_M1;         // reset starting PAIR STATE (which may be needed if Accessory failed in middle of pair-setup)
   }
 
   for(int i=0;i<maxConnections;i++){                     // loop over all HAP Connection slots
+
+    if(!hap[i])                                           // empty slot
+      continue;
+
+    if(!hap[i]->client){                                  // client has disconnected - free connection state so slot memory is only used while connected
+      releaseSlot(i);
+      continue;
+    }
+
+    if(connectionTimeout && hap[i]->client && millis()-hap[i]->lastActivity>connectionTimeout){     // connection has been idle too long
+      LOG1("** Closing idle Client #");
+      LOG1(i);
+      LOG1("  (");
+      LOG1(millis()/1000);
+      LOG1(" sec) ");
+      LOG1(hap[i]->nEvents);
+      LOG1(" unacknowledged events\n");
+      LOG_EVENT(REAP,i,0,hap[i]->nEvents,0);
+      hap[i]->nWasted+=hap[i]->nEvents;
+      hap[i]->nEvents=0;
+      hap[i]->client.stop();
+      releaseSlot(i);
+      continue;
+    }
+
+    hap[i]->drainTx();                                    // send any data still queued for this client
     
-    if(hap[i]->client && hap[i]->client.available()){       // if connection exists and data is available
+    if(hap[i]->client && !hap[i]->stopPending && hap[i]->client.available()){       // if connection exists, is not waiting to be closed, and data is available
 
       HAPClient::conNum=i;                                // set connection number
+      hap[i]->lastActivity=millis();                      // record activity for use in choosing a slot to free when all are in use
+      hap[i]->nEvents=0;
       hap[i]->processRequest();                           // process HAP request
       
       if(!hap[i]->client){                                 // client disconnected by server
@@ -248,8 +321,10 @@ void Span::poll() {
     } // process HAP Client 
   } // for-loop over connection slots
 
+  releaseDeleted();                 // apply any Accessory changes made since the last poll() before calling Services
   HAPClient::callServiceLoops();
   HAPClient::checkPushButtons();
+  releaseDeleted();                 // apply any Accessory changes made from within a Service's loop() or button() before sending Event Notifications
   HAPClient::checkNotifications();  
   HAPClient::checkTimedWrites();
 
@@ -269,6 +344,13 @@ void Span::poll() {
       commandMode();                    // COMMAND MODE
     }
   }
+
+#if HOMESPAN_LOG_RING>0
+  logRing.drain();                      // decode any queued log events that fit in the Serial transmit buffer
+#endif
+
+  if(pollTimeout)
+    idleWait();                         // block until new activity, or next scheduled event, if nothing is pending
     
 } // poll
 
@@ -277,13 +359,143 @@ void Span::poll() {
 int Span::getFreeSlot(){
   
   for(int i=0;i<maxConnections;i++){
-    if(!hap[i]->client)
+    if(!hap[i] || !hap[i]->client)
       return(i);
   }
 
   return(-1);          
 }
 
+///////////////////////////////
+
+void Span::releaseSlot(int slot){
+
+  LOG_EVENT(DISCONNECT,slot,0,0,0);
+
+  HAPClient::totalWasted+=hap[slot]->nWasted;
+  hap[slot]->clearTx();
+  delete hap[slot];
+  hap[slot]=NULL;
+}
+
+///////////////////////////////
+
+int Span::getEvictSlot(){
+
+  unsigned long cTime=millis();
+  int slot=0;
+
+  for(int i=1;i<maxConnections;i++){
+    boolean verified=(hap[i]->cPair!=NULL);
+    boolean slotVerified=(hap[slot]->cPair!=NULL);
+
+    if(verified!=slotVerified){                   // prefer freeing an unverified connection over a verified one
+      if(!verified)
+        slot=i;
+    } else
+    
+    if(cTime-hap[i]->lastActivity > cTime-hap[slot]->lastActivity){      // otherwise prefer freeing the connection that has been idle longest
+      slot=i;
+    }
+  }
+
+  return(slot);
+}
+
+///////////////////////////////
+
+uint32_t Span::nextDeadline(){
+
+  if(!isInitialized || !Notifications.empty() || Serial.available())      // still initializing, or there are pending Event Notifications or Serial commands
+    return(0);
+
+  if(!controlButton.idle())                                               // Control Button press in progress
+    return(0);
+
+  for(int i=0;i<PushButtons.size();i++){
+    if(!PushButtons[i]->pushButton->idle())                              // SpanButton press in progress
+      return(0);
+  }
+
+  for(int i=0;i<maxConnections;i++){
+    if(hap[i] && hap[i]->client && hap[i]->client.available())            // data already received and buffered for a HAP Client
+      return(0);
+  }
+
+  unsigned long cTime=millis();
+  uint32_t waitTime=pollTimeout;
+
+  if(!TimedWrites.empty()){                                               // wake up in time to clear expired Timed Writes
+    uint32_t alarm=TimedWrites.nextAlarm();
+    if(!SpanTimedWrites::before(cTime,alarm))
+      return(0);
+    if(alarm-cTime+1<waitTime)
+      waitTime=alarm-cTime+1;
+  }
+
+  if(connectionTimeout){                                                   // wake up in time to close idle connections
+    for(int i=0;i<maxConnections;i++){
+      if(hap[i] && hap[i]->client){
+        unsigned long idle=cTime-hap[i]->lastActivity;
+        if(idle>=connectionTimeout)
+          return(0);
+        if(connectionTimeout-idle+1<waitTime)
+          waitTime=connectionTimeout-idle+1;
+      }
+    }
+  }
+
+  if(strlen(network.wifiData.ssid)>0 && !connected){                      // wake up in time for next WiFi connection attempt
+    if(alarmConnect<=cTime)
+      return(0);
+    if(alarmConnect-cTime<waitTime)
+      waitTime=alarmConnect-cTime;
+  }
+
+  return(waitTime);
+}
+
+///////////////////////////////
+
+void Span::idleWait(){
+
+  uint32_t waitTime=nextDeadline();
+
+  if(!waitTime)
+    return;
+
+  fd_set readSet;
+  fd_set writeSet;
+  int maxFD=-1;
+
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+
+  for(int i=0;i<maxConnections;i++){                  // wait on sockets of all connected HAP Clients
+    if(hap[i] && hap[i]->client){
+      int fd=hap[i]->client.fd();
+      FD_SET(fd,&readSet);
+      if(hap[i]->txLen)                               // also wait for room to send any queued data
+        FD_SET(fd,&writeSet);
+      if(fd>maxFD)
+        maxFD=fd;
+    }
+  }
+
+  struct timeval tv;
+  tv.tv_sec=waitTime/1000;
+  tv.tv_usec=(waitTime%1000)*1000;
+
+  int64_t startTime=esp_timer_get_time();
+
+  if(maxFD>=0)
+    select(maxFD+1,&readSet,&writeSet,NULL,&tv);      // block until a HAP Client has data (or disconnects), queued data can be sent, or the timeout expires
+  else
+    delay(waitTime);                                  // no HAP Clients to wait on --- simply wait for timeout to expire
+
+  idleTime+=esp_timer_get_time()-startTime;
+}
+
 //////////////////////////////////////
 
 void Span::commandMode(){
@@ -567,6 +779,8 @@ void Span::setQRID(const char *id){
 
 void Span::processSerialCommand(const char *c){
 
+  logOut->flush();              // write out any buffered log messages so they are not interleaved with output of command
+
   switch(c[0]){
 
     case 's': {    
@@ -589,7 +803,7 @@ void Span::processSerialCommand(const char *c){
         Serial.print("Connection #");
         Serial.print(i);
         Serial.print(" ");
-        if(hap[i]->client){
+        if(hap[i] && hap[i]->client){
       
           Serial.print(hap[i]->client.remoteIP());
           Serial.print(" on Socket ");
@@ -604,6 +818,21 @@ void Span::processSerialCommand(const char *c){
           } else {
             Serial.print("  (unverified)");
           }
+
+          Serial.print("  idle=");
+          Serial.print((millis()-hap[i]->lastActivity)/1000);
+          Serial.print("s  events since last request=");
+          Serial.print(hap[i]->nEvents);
+
+          if(hap[i]->txLen){
+            Serial.print("  queued bytes=");
+            Serial.print(hap[i]->txLen-hap[i]->txSent);
+          }
+
+          if(hap[i]->nWasted){
+            Serial.print("  wasted writes=");
+            Serial.print(hap[i]->nWasted);
+          }
       
         } else {
           Serial.print("(unconnected)");
@@ -612,10 +841,63 @@ void Span::processSerialCommand(const char *c){
         Serial.print("\n");
       }
 
+      if(HAPClient::totalWasted){
+        Serial.print("\nWasted writes on closed connections: ");
+        Serial.print(HAPClient::totalWasted);
+        Serial.print("\n");
+      }
+
+      if(logOut==&logBuffer){
+        Serial.print("\nLog Buffer:        ");
+        Serial.print(logBufferSize);
+        Serial.print(" bytes  (");
+        Serial.print(logBuffer.dropped());
+        Serial.print(" bytes dropped)\n");
+      }
+
+      if(pollTimeout){
+        Serial.print("\nPoll Timeout:      ");
+        Serial.print(pollTimeout);
+        Serial.print(" ms  (idle ");
+        Serial.print(100.0*idleTime/esp_timer_get_time(),1);
+        Serial.print("% of uptime)\n");
+      }
+
       Serial.print("\n*** End Status ***\n\n");
     } 
     break;
 
+    case 'p': {
+
+      if(c[1+strspn(c+1," ")]=='0'){
+        Stats.reset();
+        resetCallbackTimes();
+        Serial.print("\n*** Performance Statistics Reset ***\n\n");
+        break;
+      }
+      
+      Serial.print("\n*** HomeSpan Performance Statistics ***\n\n");
+      Stats.print();
+      Serial.print("\n");
+      printCallbackTimes();
+      Serial.print("\n*** End Statistics ***\n\n");
+    }
+    break;
+
+    case 'm': {
+      Memory.print();
+    }
+    break;
+
+    case 'P': {
+
+      TempBuffer <char> jBuf(Stats.sprintfJSON(NULL)+1);
+      Stats.sprintfJSON(jBuf.buf);
+      Serial.print(jBuf.buf);
+      Serial.print("\n");
+    }
+    break;
+
     case 'd': {      
       
       TempBuffer <char> qBuf(sprintfAttributes(NULL)+1);
@@ -728,7 +1010,7 @@ void Span::processSerialCommand(const char *c){
       Serial.print("\n*** HomeSpan Pairing Data DELETED ***\n\n");
       
       for(int i=0;i<maxConnections;i++){     // loop over all connection slots
-        if(hap[i]->client){                    // if slot is connected
+        if(hap[i] && hap[i]->client){          // if slot is connected
           LOG1("*** Terminating Client #");
           LOG1(i);
           LOG1("\n");
@@ -869,8 +1151,8 @@ void Span::processSerialCommand(const char *c){
       
       if(level<0)
         level=0;
-      if(level>2)
-        level=2;
+      if(level>HOMESPAN_MAX_LOG_LEVEL)
+        level=HOMESPAN_MAX_LOG_LEVEL;
 
       Serial.print("\n*** Log Level set to ");
       Serial.print(level);
@@ -884,7 +1166,7 @@ void Span::processSerialCommand(const char *c){
 
       Serial.print("\n*** HomeSpan Info ***\n\n");
 
-      Serial.print(configLog);
+      printConfig();
       Serial.print("\nConfigured as Bridge: ");
       Serial.print(homeSpan.isBridge?"YES":"NO");
       Serial.print("\n\n");
@@ -910,6 +1192,9 @@ void Span::processSerialCommand(const char *c){
           Serial.print("\n");
         }
       }
+      Budget.compute();
+      Budget.print();
+
       Serial.print("\n*** End Info ***\n");
     }
     break;
@@ -920,6 +1205,9 @@ void Span::processSerialCommand(const char *c){
       Serial.print("  s - print connection status\n");
       Serial.print("  i - print summary information about the HAP Database\n");
       Serial.print("  d - print the full HAP Accessory Attributes Database in JSON format\n");
+      Serial.print("  p - print request counters and latency statistics (p0 to reset)\n");
+      Serial.print("  P - print request counters and latency statistics in JSON format\n");
+      Serial.print("  m - print heap usage by subsystem\n");
       Serial.print("\n");      
       Serial.print("  W - configure WiFi Credentials and restart\n");      
       Serial.print("  X - delete WiFi Credentials and restart\n");      
@@ -971,6 +1259,139 @@ void Span::processSerialCommand(const char *c){
 
 ///////////////////////////////
 
+void Span::printConfigRecord(const SpanConfigRecord &r){
+
+  SpanCharacteristic *chr=(SpanCharacteristic *)r.obj;
+  SpanService *svc=(SpanService *)r.obj;
+  SpanButton *button=(SpanButton *)r.obj;
+
+  switch(r.kind){
+
+    case SpanConfigRecord::ACCESSORY:
+      Serial.printf("\u27a4 Accessory:  AID=%u",((SpanAccessory *)r.obj)->aid);
+    break;
+
+    case SpanConfigRecord::SERVICE:
+      Serial.printf("   \u279f Service %s",svc->hapName);
+      if(!(r.flag&SpanConfigRecord::ORPHAN))
+        Serial.printf(":  IID=%d, UUID=0x%s",svc->iid,svc->type);
+    break;
+
+    case SpanConfigRecord::CHARACTERISTIC:
+      Serial.printf("      \u21e8 Characteristic %s",chr->hapChar->hapName);
+      if(r.flag&SpanConfigRecord::ORPHAN)
+        break;
+      Serial.printf("(%s):  IID=%d, UUID=0x%s",chr->uvPrint(chr->value()).c_str(),chr->iid(),chr->hapChar->type);
+      if(chr->hapChar->format!=FORMAT::STRING && chr->hapChar->format!=FORMAT::BOOL && (chr->initRange || chr->hapChar->hasRange())){
+        UVal minValue, maxValue;
+        chr->uvSet(minValue,chr->initRange?chr->minRange():chr->hapChar->minValue);
+        chr->uvSet(maxValue,chr->initRange?chr->maxRange():chr->hapChar->maxValue);
+        Serial.printf("  Range=[%s,%s]",chr->uvPrint(minValue).c_str(),chr->uvPrint(maxValue).c_str());
+      }
+      if(r.flag&SpanConfigRecord::RESTORED)
+        Serial.print(" (restored)");
+      else if(r.flag&SpanConfigRecord::STORING)
+        Serial.print(" (storing)");
+      else if(r.flag&SpanConfigRecord::STORED)
+        Serial.print(" (stored)");
+    break;
+
+    case SpanConfigRecord::RANGE:
+      Serial.printf("         \u2b0c Set Range for %s with IID=%d",chr->hapChar->hapName,chr->iid());
+      if(r.flag&SpanConfigRecord::FAILED)
+        break;
+      Serial.printf(": Min=%s, Max=%s",chr->uvPrint(chr->customRange[0]).c_str(),chr->uvPrint(chr->customRange[1]).c_str());
+      if(chr->uvGet<double>(chr->customRange[2])>0)
+        Serial.printf(", Step=%s",chr->uvPrint(chr->customRange[2]).c_str());
+    break;
+
+    case SpanConfigRecord::BUTTON:
+      Serial.printf("      \u25bc SpanButton: Pin=%d, Single=%ums, Double=%ums, Long=%ums",button->pin,button->singleTime,button->doubleTime,button->longTime);
+    break;
+
+    case SpanConfigRecord::OUT_OF_RANGE:
+      Serial.printf("      \u2718 Characteristic %s with IID=%d  *** WARNING: Initial value of %lg is out of range [%llg,%llg]. ***",
+                    chr->hapChar->hapName,chr->iid(),chr->uvGet<double>(chr->value()),chr->minRange(),chr->maxRange());
+    break;
+
+    case SpanConfigRecord::MISSING_SERVICE:
+      Serial.printf("   \u2718 Service %s",(const char *)r.obj);
+    break;
+
+    case SpanConfigRecord::MISSING_CHARACTERISTIC:
+      Serial.printf("      \u2718 Characteristic %s",((const HapChar *)r.obj)->hapName);
+    break;
+
+    case SpanConfigRecord::ORPHAN_RANGE:
+      Serial.print("    \u2718 SpanRange:");
+    break;
+
+    case SpanConfigRecord::NOTE:
+      Serial.print((const char *)r.obj);
+    break;
+  }
+}
+
+///////////////////////////////
+
+void Span::printConfigRecords(){
+
+  for(int i=0;i<configLog.size();i++){
+    if(i>0 && configLog[i].kind!=SpanConfigRecord::NOTE)          // every record other than a NOTE starts a new line
+      Serial.print("\n");
+    printConfigRecord(configLog[i]);
+  }
+  Serial.print("\n");
+}
+
+///////////////////////////////
+
+void Span::printConfig(){
+
+  if(!configLog.empty()){                                         // records from start-up are still available
+    printConfigRecords();
+  } else {                                                        // records were discarded once HomeSpan started running, so re-create them from the database (any errors or warnings were reported at start-up)
+    for(int i=0;i<Accessories.size();i++){
+      printConfigRecord({SpanConfigRecord::ACCESSORY,0,Accessories[i]});
+      Serial.print("\n");
+      for(int j=0;j<Accessories[i]->Services.size();j++){
+        SpanService *svc=Accessories[i]->Services[j];
+        printConfigRecord({SpanConfigRecord::SERVICE,0,svc});
+        Serial.print("\n");
+        for(int k=0;k<svc->Characteristics.size();k++){
+          SpanCharacteristic *chr=svc->Characteristics[k];
+          printConfigRecord({SpanConfigRecord::CHARACTERISTIC,(uint8_t)(chr->nvsStore?SpanConfigRecord::STORED:0),chr});
+          Serial.print("\n");
+          if(chr->customRange && !chr->initRange){
+            printConfigRecord({SpanConfigRecord::RANGE,0,chr});
+            Serial.print("\n");
+          }
+        }
+        for(int k=0;k<PushButtons.size();k++){
+          if(PushButtons[k]->service==svc){
+            printConfigRecord({SpanConfigRecord::BUTTON,0,PushButtons[k]});
+            Serial.print("\n");
+          }
+        }
+      }
+    }
+  }
+
+  Serial.printf("\nDatabase Ready:   %lu ms after boot, %u bytes heap free (%u minimum)\n",readyTime,readyHeap,readyMinHeap);
+
+  if(!Budget.fits()){
+    Serial.printf("\n*** WARNING!  Estimated run-time memory needed (%u bytes, including %u-byte /accessories response) exceeds available heap (%u bytes).",Budget.peakBytes,Budget.jsonBytes,Budget.freeBytes);
+    Serial.printf(" This device can support approximately %d Accessories of this size. ***\n",Budget.maxAccessories());
+  }
+
+  if(nWarnings>0){
+    Serial.printf("\n*** CAUTION: There %s %d WARNING%s associated with this configuration that may lead to the device becoming non-responsive, or operating in an unexpected manner. ***\n",
+                  nWarnings>1?"are":"is",nWarnings,nWarnings>1?"S":"");
+  }
+}
+
+///////////////////////////////
+
 void Span::setWifiCredentials(const char *ssid, const char *pwd){
   sprintf(network.wifiData.ssid,"%.*s",MAX_SSID,ssid);
   sprintf(network.wifiData.pwd,"%.*s",MAX_PWD,pwd);
@@ -1045,93 +1466,363 @@ void Span::prettyPrint(char *buf, int nsp){
 
 SpanCharacteristic *Span::find(uint32_t aid, int iid){
 
-  int index=-1;
-  for(int i=0;i<Accessories.size();i++){   // loop over all Accessories to find aid
-    if(Accessories[i]->aid==aid){          // if match, save index into Accessories array
-      index=i;
-      break;
-    }
-  }
+  uint64_t key=((uint64_t)aid<<32)|(uint32_t)iid;
+  auto it=std::lower_bound(charKeys.begin(),charKeys.end(),key);      // binary search of contiguous array of keys
 
-  if(index<0)                  // fail if no match on aid
+  if(it==charKeys.end() || *it!=key)          // fail if no match on aid/iid
     return(NULL);
-    
-  for(int i=0;i<Accessories[index]->Services.size();i++){                           // loop over all Services in this Accessory
-    for(int j=0;j<Accessories[index]->Services[i]->Characteristics.size();j++){     // loop over all Characteristics in this Service
-      
-      if(iid == Accessories[index]->Services[i]->Characteristics[j]->iid)           // if matching iid
-        return(Accessories[index]->Services[i]->Characteristics[j]);                // return pointer to Characteristic
+
+  return(charIndex[it-charKeys.begin()]);
+}
+
+///////////////////////////////
+
+void Span::buildIndex(){
+
+  vector<std::pair<uint64_t,SpanCharacteristic *>> pairs;
+
+  for(int i=0;i<Accessories.size();i++){
+    for(int j=0;j<Accessories[i]->Services.size();j++){
+      for(int k=0;k<Accessories[i]->Services[j]->Characteristics.size();k++){
+        SpanCharacteristic *c=Accessories[i]->Services[j]->Characteristics[k];
+        pairs.push_back({((uint64_t)c->aid()<<32)|(uint32_t)c->iid(),c});
+      }
     }
   }
 
-  return(NULL);                // fail if no match on iid
+  std::sort(pairs.begin(),pairs.end());
+
+  charKeys.clear();
+  charIndex.clear();
+  charKeys.reserve(pairs.size());
+  charIndex.reserve(pairs.size());
+  
+  for(int i=0;i<pairs.size();i++){
+    charKeys.push_back(pairs[i].first);
+    charIndex.push_back(pairs[i].second);
+  }
 }
 
 ///////////////////////////////
 
-int Span::countCharacteristics(char *buf){
+void Span::indexAccessory(SpanAccessory *acc){
 
-  int nObj=0;
+  vector<std::pair<uint64_t,SpanCharacteristic *>> pairs;
+
+  for(int j=0;j<acc->Services.size();j++){
+    for(int k=0;k<acc->Services[j]->Characteristics.size();k++){
+      SpanCharacteristic *c=acc->Services[j]->Characteristics[k];
+      pairs.push_back({((uint64_t)c->aid()<<32)|(uint32_t)c->iid(),c});
+    }
+  }
+
+  std::sort(pairs.begin(),pairs.end());
+
+  int n=std::lower_bound(charKeys.begin(),charKeys.end(),(uint64_t)acc->aid<<32)-charKeys.begin();     // keys of all Characteristics in this Accessory are contiguous, starting here
   
-  const char tag[]="\"aid\"";
-  while((buf=strstr(buf,tag))){         // count number of characteristic objects in PUT JSON request
-    nObj++;
-    buf+=strlen(tag);
+  charKeys.insert(charKeys.begin()+n,pairs.size(),0);
+  charIndex.insert(charIndex.begin()+n,pairs.size(),NULL);
+
+  for(int i=0;i<pairs.size();i++){
+    charKeys[n+i]=pairs[i].first;
+    charIndex[n+i]=pairs[i].second;
   }
+}
 
-  return(nObj);
+///////////////////////////////
+
+void Span::unindexAccessory(uint32_t aid){
+
+  auto first=std::lower_bound(charKeys.begin(),charKeys.end(),(uint64_t)aid<<32);
+  auto last=std::lower_bound(first,charKeys.end(),((uint64_t)aid+1)<<32);
+
+  charIndex.erase(charIndex.begin()+(first-charKeys.begin()),charIndex.begin()+(last-charKeys.begin()));
+  charKeys.erase(first,last);
 }
 
 ///////////////////////////////
 
-int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
+void Span::buildLoops(){
 
-  int nObj=0;
-  char *p1;
-  int cFound=0;
-  boolean twFail=false;
-  
-  while(char *t1=strtok_r(buf,"{",&p1)){           // parse 'buf' and extract objects into 'pObj' unless NULL
-   buf=NULL;
-    char *p2;
-    int okay=0;
-    
-    while(char *t2=strtok_r(t1,"}[]:, \"\t\n\r",&p2)){
+  Loops.clear();
 
-      if(!cFound){                                 // first token found
-        if(strcmp(t2,"characteristics")){
-          Serial.print("\n*** ERROR:  Problems parsing JSON - initial \"characteristics\" tag not found\n\n");
-          return(0);
+  for(int i=0;i<Accessories.size();i++){                             // identify all services with over-ridden loop() methods
+    for(int j=0;j<Accessories[i]->Services.size();j++){
+      SpanService *s=Accessories[i]->Services[j];      
+      if((void(*)())(s->*(&SpanService::loop)) != (void(*)())(&SpanService::loop))    // save pointers to services in Loops vector
+        Loops.push_back(s);
+    }
+  }
+}
+
+///////////////////////////////
+
+uint64_t Span::fingerprint(){
+
+  uint64_t hash=0xCBF29CE484222325;                     // FNV-1a offset basis
+
+  auto add=[&hash](const void *data, size_t len){
+    for(size_t i=0;i<len;i++){
+      hash^=((const uint8_t *)data)[i];
+      hash*=0x100000001B3;                              // FNV-1a prime
+    }
+  };
+
+  for(int i=0;i<Accessories.size();i++){
+    add(&Accessories[i]->aid,sizeof(uint32_t));
+    for(int j=0;j<Accessories[i]->Services.size();j++){
+      SpanService *s=Accessories[i]->Services[j];
+      add(&s->iid,sizeof(int));
+      add(s->type,strlen(s->type));
+      add(&s->hidden,sizeof(boolean));
+      add(&s->primary,sizeof(boolean));
+      for(int k=0;k<s->linkedServices.size();k++)
+        add(&s->linkedServices[k]->iid,sizeof(int));
+      for(int k=0;k<s->Characteristics.size();k++){
+        SpanCharacteristic *c=s->Characteristics[k];
+        add(&c->iid(),sizeof(int));
+        add(c->hapChar->type,strlen(c->hapChar->type));
+        add(&c->hapChar->perms,sizeof(PERMS));
+        add(&c->hapChar->format,sizeof(FORMAT));
+        double range[3]={c->minRange(),c->maxRange(),c->customRange?c->uvGet<double>(c->customRange[2]):0};
+        add(range,sizeof(range));
+        if(c->desc)
+          add(c->desc,strlen(c->desc));
+        if(c->hapChar->format==FORMAT::STRING){            // values that identify the device (Name, Model, SerialNumber, FirmwareRevision, etc.) are all strings...
+          if(c->value().STRING)
+            add(c->value().STRING,strlen(c->value().STRING));
+        } else if(!(c->hapChar->perms&EV)){                // ...and other values that cannot generate events are static as well
+          double v=c->uvGet<double>(c->value());
+          add(&v,sizeof(v));
         }
-        cFound=1;
-        break;
       }
-      
-      t1=NULL;
-      char *t3;
-      if(!strcmp(t2,"aid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        sscanf(t3,"%u",&pObj[nObj].aid);
-        okay|=1;
-      } else 
-      if(!strcmp(t2,"iid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        pObj[nObj].iid=atoi(t3);
-        okay|=2;
-      } else 
-      if(!strcmp(t2,"value") && (t3=strtok_r(t1,"}[]:,\"",&p2))){
-        pObj[nObj].val=t3;
-        okay|=4;
-      } else 
-      if(!strcmp(t2,"ev") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
-        pObj[nObj].ev=t3;
-        okay|=8;
+    }
+  }
+
+  return(hash);
+}
+
+///////////////////////////////
+
+void Span::checkFatalErrors(){
+
+  if(nFatalErrors>0){
+    Serial.print("\n*** PROGRAM HALTED DUE TO ");
+    Serial.print(nFatalErrors);
+    Serial.print(" FATAL ERROR");
+    if(nFatalErrors>1)
+      Serial.print("S");
+    Serial.print(" IN CONFIGURATION! ***\n\n");
+    while(1);
+  }    
+}
+
+///////////////////////////////
+
+boolean Span::deleteAccessory(uint32_t aid){
+
+  if(!isInitialized || !configLog.empty())      // configuration records (from start-up, or from Accessories added but not yet published with updateDatabase()) still point into the database
+    return(false);
+
+  if(aid==1){
+    Serial.print("\n*** WARNING:  Can't delete Accessory with AID=1. ***\n\n");
+    return(false);
+  }
+
+  auto it=std::find_if(Accessories.begin(),Accessories.end(),[aid](SpanAccessory *acc){return(acc->aid==aid);});
+
+  if(it==Accessories.end())
+    return(false);
+
+  SpanAccessory *acc=*it;
+
+  unindexAccessory(aid);            // Event Notification subscriptions are stored in each Characteristic, so they are dropped once the Characteristics are removed from the index and deleted
+  Accessories.erase(it);
+  aids.erase(aid);
+
+  Deleted.push_back(acc);           // Accessory may still be referenced by Loops or PushButtons (which may be being iterated right now), so freeing it is deferred to releaseDeleted()
+  loopsChanged=true;
+
+  LOG1("Deleted Accessory AID=");
+  LOG1(aid);
+  LOG1("\n");
+
+  return(true);
+}
+
+///////////////////////////////
+
+void Span::releaseDeleted(){
+
+  if(!loopsChanged)
+    return;
+
+  for(int n=0;n<Deleted.size();n++){
+    vector<SpanService *> &svcs=Deleted[n]->Services;
+    auto inAccessory=[&svcs](SpanService *svc){return(std::find(svcs.begin(),svcs.end(),svc)!=svcs.end());};
+
+    for(int i=PushButtons.size()-1;i>=0;i--){                          // delete PushButtons attached to any Service in this Accessory
+      if(inAccessory(PushButtons[i]->service)){
+        delete PushButtons[i];
+        PushButtons.erase(PushButtons.begin()+i);
+      }
+    }
+
+    Notifications.erase(std::remove_if(Notifications.begin(),Notifications.end(),           // drop any pending Event Notifications for this Accessory's Characteristics
+                        [&inAccessory](SpanBuf &sb){return(inAccessory(sb.characteristic->service));}),Notifications.end());
+
+    delete Deleted[n];
+  }
+
+  Deleted.clear();
+  buildLoops();
+  loopsChanged=false;
+}
+
+///////////////////////////////
+
+boolean Span::updateDatabase(){
+
+  if(!isInitialized)              // database is validated and published by poll() at start-up
+    return(false);
+
+  uint32_t startTime=micros();
+
+  if(!Accessories.empty())
+    Accessories.back()->validate();                   // any earlier Accessories added since start-up were validated when the next one was created
+
+  vector<SpanAccessory *> added;                     // Accessories created since start-up or the last update (each one starts with an ACCESSORY configuration record)
+
+  if(!configLog.empty()){
+    Serial.print("\n*** HomeSpan Database Update ***\n\n");
+    printConfigRecords();
+    for(int i=0;i<configLog.size();i++){
+      if(configLog[i].kind==SpanConfigRecord::ACCESSORY)
+        added.push_back((SpanAccessory *)configLog[i].obj);
+    }
+    vector<SpanConfigRecord>().swap(configLog);
+  }
+
+  boolean reject=false;
+
+  if(nFatalErrors>0){                                // unlike at start-up, don't halt a running bridge - reject the new Accessories instead
+    Serial.printf("\n*** ERROR!  %d FATAL ERROR%s IN ADDED ACCESSORIES.  %d ACCESSOR%s NOT ADDED. ***\n",
+                  nFatalErrors,nFatalErrors>1?"S":"",(int)added.size(),added.size()>1?"IES":"Y");
+    reject=true;
+  } else if(!added.empty()){                        // limit number of Accessories to what fits in the memory actually available, rather than just the HAP limit
+    Budget.compute();
+    if(!Budget.fits()){
+      Serial.printf("\n*** ERROR!  Estimated run-time memory needed (%u bytes) exceeds available heap (%u bytes).  This device can support approximately %d Accessories of this size.  %d ACCESSOR%s NOT ADDED. ***\n",
+                    Budget.peakBytes,Budget.freeBytes,Budget.maxAccessories(),(int)added.size(),added.size()>1?"IES":"Y");
+      reject=true;
+    }
+  }
+
+  if(reject){
+    for(int i=0;i<added.size();i++){
+      SpanAccessory *acc=added[i];
+      Accessories.erase(std::find(Accessories.begin(),Accessories.end(),acc));
+      if(std::none_of(Accessories.begin(),Accessories.end(),[acc](SpanAccessory *a){return(a->aid==acc->aid);}))     // aid was not a duplicate of an existing Accessory
+        aids.erase(acc->aid);
+      Deleted.push_back(acc);                        // any SpanButtons the Accessory created are freed along with it by releaseDeleted()
+    }
+    nFatalErrors=0;
+  }
+
+  for(int i=0;i<Accessories.size();i++){             // add any Accessories not already found in index
+    auto it=std::lower_bound(charKeys.begin(),charKeys.end(),(uint64_t)Accessories[i]->aid<<32);
+    if(it==charKeys.end() || (uint32_t)(*it>>32)!=Accessories[i]->aid)
+      indexAccessory(Accessories[i]);
+  }
+
+  loopsChanged=true;                                 // Loops are rebuilt by releaseDeleted(), since this method may be called from within a Service's loop()
+
+  Budget.compute();                                  // also re-computes size of /accessories response
+  if(!Budget.fits())
+    Serial.printf("\n*** WARNING!  Estimated run-time memory needed (%u bytes) exceeds available heap (%u bytes). ***\n",Budget.peakBytes,Budget.freeBytes);
+
+  Serial.print("\n");
+  boolean changed=HAPClient::checkConfigNumber();
+
+  if(changed && connected){                          // MDNS is already running, so update its "c#" record (otherwise checkConnect() sets it from hapConfig when MDNS starts)
+    char cNum[16];
+    sprintf(cNum,"%d",hapConfig.configNumber);
+    mdns_service_txt_item_set("_hap","_tcp","c#",cNum);
+  }
+
+  LOG1("Database updated in ");
+  LOG1(micros()-startTime);
+  LOG1(" us\n");
+
+  return(changed);
+}
+
+///////////////////////////////
+
+int Span::countCharacteristics(char *buf){
+
+  int nObj=0;
+  
+  const char tag[]="\"aid\"";
+  while((buf=strstr(buf,tag))){         // count number of characteristic objects in PUT JSON request
+    nObj++;
+    buf+=strlen(tag);
+  }
+
+  return(nObj);
+}
+
+///////////////////////////////
+
+int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
+
+  int nObj=0;
+  char *p1;
+  int cFound=0;
+  boolean twFail=false;
+  
+  while(char *t1=strtok_r(buf,"{",&p1)){           // parse 'buf' and extract objects into 'pObj' unless NULL
+   buf=NULL;
+    char *p2;
+    int okay=0;
+    
+    while(char *t2=strtok_r(t1,"}[]:, \"\t\n\r",&p2)){
+
+      if(!cFound){                                 // first token found
+        if(strcmp(t2,"characteristics")){
+          Serial.print("\n*** ERROR:  Problems parsing JSON - initial \"characteristics\" tag not found\n\n");
+          return(0);
+        }
+        cFound=1;
+        break;
+      }
+      
+      t1=NULL;
+      char *t3;
+      if(!strcmp(t2,"aid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
+        sscanf(t3,"%u",&pObj[nObj].aid);
+        okay|=1;
+      } else 
+      if(!strcmp(t2,"iid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
+        pObj[nObj].iid=atoi(t3);
+        okay|=2;
+      } else 
+      if(!strcmp(t2,"value") && (t3=strtok_r(t1,"}[]:,\"",&p2))){
+        pObj[nObj].val=t3;
+        okay|=4;
+      } else 
+      if(!strcmp(t2,"ev") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){
+        pObj[nObj].ev=t3;
+        okay|=8;
       } else 
       if(!strcmp(t2,"pid") && (t3=strtok_r(t1,"}[]:, \"\t\n\r",&p2))){        
         uint64_t pid=strtoull(t3,NULL,0);        
-        if(!TimedWrites.count(pid)){
+        int twStatus=TimedWrites.check(pid,millis());
+        if(twStatus==0){
           Serial.print("\n*** ERROR:  Timed Write PID not found\n\n");
           twFail=true;
         } else        
-        if(millis()>TimedWrites[pid]){
+        if(twStatus<0){
           Serial.print("\n*** ERROR:  Timed Write Expired\n\n");
           twFail=true;
         }        
@@ -1175,25 +1866,29 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
   for(int i=0;i<nObj;i++){                                     // PASS 2: loop again over all objects       
     if(pObj[i].status==StatusCode::TBD){                       // if object status still TBD
 
+      uint32_t startTime=micros();
       StatusCode status=pObj[i].characteristic->service->update()?StatusCode::OK:StatusCode::Unable;                  // update service and save statusCode as OK or Unable depending on whether return is true or false
+      timeCallback(pObj[i].characteristic->service,"update",startTime);
 
       for(int j=i;j<nObj;j++){                                                      // loop over this object plus any remaining objects to update values and save status for any other characteristics in this service
         
         if(pObj[j].characteristic->service==pObj[i].characteristic->service){       // if service of this characteristic matches service that was updated
           pObj[j].status=status;                                                    // save statusCode for this object
           LOG1("Updating aid=");
-          LOG1(pObj[j].characteristic->aid);
+          LOG1(pObj[j].characteristic->aid());
           LOG1(" iid=");  
-          LOG1(pObj[j].characteristic->iid);
+          LOG1(pObj[j].characteristic->iid());
           if(status==StatusCode::OK){                                                     // if status is okay
-            pObj[j].characteristic->value=pObj[j].characteristic->newValue;               // update characteristic value with new value
-            if(pObj[j].characteristic->nvsKey){                                                                                               // if storage key found
-              nvs_set_blob(charNVS,pObj[j].characteristic->nvsKey,&(pObj[j].characteristic->value),sizeof(pObj[j].characteristic->value));    // store data
+            pObj[j].characteristic->value()=pObj[j].characteristic->newValue;               // update characteristic value with new value
+            if(pObj[j].characteristic->nvsStore){                                                                                             // if characteristic is stored in NVS
+              char nvsKey[16];
+              pObj[j].characteristic->getNvsKey(nvsKey);
+              nvs_set_blob(charNVS,nvsKey,&(pObj[j].characteristic->value()),sizeof(pObj[j].characteristic->value()));                            // store data
               nvs_commit(charNVS);
             }
             LOG1(" (okay)\n");
           } else {                                                                        // if status not okay
-            pObj[j].characteristic->newValue=pObj[j].characteristic->value;               // replace characteristic new value with original value
+            pObj[j].characteristic->newValue=pObj[j].characteristic->value();               // replace characteristic new value with original value
             LOG1(" (failed)\n");
           }
           pObj[j].characteristic->isUpdated=false;             // reset isUpdated flag for characteristic
@@ -1208,19 +1903,78 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj){
 
 ///////////////////////////////
 
-void Span::clearNotify(int slotNum){
+void Span::timeCallback(SpanService *svc, const char *method, uint32_t startTime){
+
+  uint32_t t=micros()-startTime;
+
+  svc->cpuTime+=t;
+  if(t>svc->maxTime)
+    svc->maxTime=t;
+
+  if(callbackBudget && t>callbackBudget){
+    svc->nStalls++;
+    LOG_EVENT(STALL,0xFF,svc->iid,svc->aid,t);
+    LOG1("*** WARNING: ");
+    LOG1(svc->hapName);
+    LOG1(" aid=");
+    LOG1(svc->aid);
+    LOG1(" iid=");
+    LOG1(svc->iid);
+    LOG1(" ");
+    LOG1(method);
+    LOG1("() took ");
+    LOG1(t/1000);
+    LOG1(" ms\n");
+  }
+}
+
+///////////////////////////////
+
+void Span::printCallbackTimes(){
+
+  uint64_t upTime=esp_timer_get_time();
+  char d[]="------------------------------";
+  
+  Serial.printf("%-30s  %10s  %3s  %10s  %6s  %8s  %6s\n","Service","AID","IID","CPU (ms)","CPU %","Max (ms)","Stalls");
+  Serial.printf("%.30s  %.10s  %.3s  %.10s  %.6s  %.8s  %.6s\n",d,d,d,d,d,d,d);
   
   for(int i=0;i<Accessories.size();i++){
     for(int j=0;j<Accessories[i]->Services.size();j++){
-      for(int k=0;k<Accessories[i]->Services[j]->Characteristics.size();k++){
-        Accessories[i]->Services[j]->Characteristics[k]->ev[slotNum]=false;
-      }
+      SpanService *s=Accessories[i]->Services[j];
+      if(s->cpuTime)
+        Serial.printf("%-30s  %10u  %3d  %10llu  %6.2f  %8.1f  %6u\n",s->hapName,s->aid,s->iid,s->cpuTime/1000,100.0*s->cpuTime/upTime,s->maxTime/1000.0,s->nStalls);
+    }
+  }
+
+  Serial.printf("\nStall budget: %u ms per call\n",callbackBudget/1000);
+}
+
+///////////////////////////////
+
+void Span::resetCallbackTimes(){
+
+  for(int i=0;i<Accessories.size();i++){
+    for(int j=0;j<Accessories[i]->Services.size();j++){
+      SpanService *s=Accessories[i]->Services[j];
+      s->cpuTime=0;
+      s->maxTime=0;
+      s->nStalls=0;
     }
   }
 }
 
 ///////////////////////////////
 
+void Span::clearNotify(int slotNum){
+  
+  uint32_t mask=~((uint32_t)1<<slotNum);
+
+  for(int i=0;i<charStore.ev.size();i++)        // scan of contiguous array of EV flags, rather than of each Characteristic
+    charStore.ev[i]&=mask;
+}
+
+///////////////////////////////
+
 int Span::sprintfNotify(SpanBuf *pObj, int nObj, char *cBuf, int conNum){
 
   int nChars=0;
@@ -1232,7 +1986,7 @@ int Span::sprintfNotify(SpanBuf *pObj, int nObj, char *cBuf, int conNum){
     
     if(pObj[i].status==StatusCode::OK && pObj[i].val){           // characteristic was successfully updated with a new value (i.e. not just an EV request)
       
-      if(pObj[i].characteristic->ev[conNum]){           // if notifications requested for this characteristic by specified connection number
+      if(pObj[i].characteristic->ev()&((uint32_t)1<<conNum)){           // if notifications requested for this characteristic by specified connection number
       
         if(notifyFlag)                                                           // already printed at least one other characteristic
           nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,",");               // add preceeding comma before printing next characteristic
@@ -1285,7 +2039,7 @@ int Span::sprintfAttributes(char **ids, int numIDs, int flags, char *cBuf){
     Characteristics[i]=find(aid,iid);     // find matching chararacteristic
     
     if(Characteristics[i]){                                          // if found
-      if(Characteristics[i]->perms&PERMS::PR){                       // if permissions allow reading
+      if(Characteristics[i]->hapChar->perms&PERMS::PR){                       // if permissions allow reading
         status[i]=StatusCode::OK;                                    // always set status to OK (since no actual reading of device is needed)
       } else {
         Characteristics[i]=NULL;                                     
@@ -1332,18 +2086,14 @@ SpanAccessory::SpanAccessory(uint32_t aid){
 
   if(!homeSpan.Accessories.empty()){
 
-    if(homeSpan.Accessories.size()==HAPClient::MAX_ACCESSORIES){
+    if(homeSpan.Accessories.size()>=HAPClient::MAX_ACCESSORIES && !homeSpan.isInitialized){
       Serial.print("\n\n*** FATAL ERROR: Can't create more than ");
       Serial.print(HAPClient::MAX_ACCESSORIES);
       Serial.print(" Accessories.  Program Halting.\n\n");
       while(1);      
     }
     
-    this->aid=homeSpan.Accessories.back()->aid+1;
-    
-    if(!homeSpan.Accessories.back()->Services.empty())
-      homeSpan.Accessories.back()->Services.back()->validate();    
-      
+    this->aid=(homeSpan.isInitialized?homeSpan.maxAid:homeSpan.Accessories.back()->aid)+1;
     homeSpan.Accessories.back()->validate();    
   } else {
     this->aid=1;
@@ -1355,36 +2105,54 @@ SpanAccessory::SpanAccessory(uint32_t aid){
     this->aid=aid;
   }
 
-  homeSpan.configLog+="\u27a4 Accessory:  AID=" + String(this->aid);
+  homeSpan.maxAid=std::max(homeSpan.maxAid,this->aid);
 
-  for(int i=0;i<homeSpan.Accessories.size()-1;i++){
-    if(this->aid==homeSpan.Accessories[i]->aid){
-      homeSpan.configLog+=" *** ERROR!  ID already in use for another Accessory. ***";
-      homeSpan.nFatalErrors++;
-      break;
-    }
+  homeSpan.addConfig(SpanConfigRecord::ACCESSORY,this);
+
+  if(homeSpan.Accessories.size()>HAPClient::MAX_ACCESSORIES){           // only possible after start-up - updateDatabase() rejects this Accessory
+    homeSpan.addConfigNote(" *** ERROR!  Maximum number of Accessories already reached. ***");
+    homeSpan.nFatalErrors++;
+  }
+
+  if(!homeSpan.aids.insert(this->aid).second){          // insert() returns false if aid is already in the set
+    homeSpan.addConfigNote(" *** ERROR!  ID already in use for another Accessory. ***");
+    homeSpan.nFatalErrors++;
   }
 
   if(homeSpan.Accessories.size()==1 && this->aid!=1){
-    homeSpan.configLog+=" *** ERROR!  ID of first Accessory must always be 1. ***";
+    homeSpan.addConfigNote(" *** ERROR!  ID of first Accessory must always be 1. ***");
     homeSpan.nFatalErrors++;    
   }
 
-  homeSpan.configLog+="\n";
+}
+
+///////////////////////////////
+
+SpanAccessory::~SpanAccessory(){
 
+  for(int i=0;i<Services.size();i++)
+    delete Services[i];
 }
 
 ///////////////////////////////
 
 void SpanAccessory::validate(){
 
+  if(validated)
+    return;
+
+  validated=true;
+
+  if(!Services.empty())                         // last Service in Accessory has not yet been validated, since no subsequent Service was created
+    Services.back()->validate();
+
   boolean foundInfo=false;
   boolean foundProtocol=false;
   
   for(int i=0;i<Services.size();i++){
-    if(!strcmp(Services[i]->type,"3E"))
+    if(Services[i]->typeNum==0x3E)
       foundInfo=true;
-    else if(!strcmp(Services[i]->type,"A2"))
+    else if(Services[i]->typeNum==0xA2)
       foundProtocol=true;
     else if(aid==1)                             // this is an Accessory with aid=1, but it has more than just AccessoryInfo and HAPProtocolInformation.  So...
       homeSpan.isBridge=false;                  // ...this is not a bridge device
@@ -1392,25 +2160,22 @@ void SpanAccessory::validate(){
     for(int j=0;j<Services[i]->Characteristics.size();j++){       // check that initial values are all in range of mix/max (which may have been modified by setRange)
       SpanCharacteristic *chr=Services[i]->Characteristics[j];
 
-      if(chr->format!=STRING && (chr->uvGet<double>(chr->value) < chr->uvGet<double>(chr->minValue) || chr->uvGet<double>(chr->value) > chr->uvGet<double>(chr->maxValue))){
-        char c[256];
-        sprintf(c,"      \u2718 Characteristic %s with IID=%d  *** WARNING: Initial value of %lg is out of range [%llg,%llg]. ***\n",
-               chr->hapName,chr->iid,chr->uvGet<double>(chr->value),chr->uvGet<double>(chr->minValue),chr->uvGet<double>(chr->maxValue));
-        homeSpan.configLog+=c;
+      if(chr->hapChar->format!=STRING && chr->hasRange() && (chr->uvGet<double>(chr->value()) < chr->minRange() || chr->uvGet<double>(chr->value()) > chr->maxRange())){
+        homeSpan.addConfig(SpanConfigRecord::OUT_OF_RANGE,chr);
         homeSpan.nWarnings++;
       }       
     }
   }
 
   if(!foundInfo){
-    homeSpan.configLog+="   \u2718 Service AccessoryInformation";
-    homeSpan.configLog+=" *** ERROR!  Required Service for this Accessory not found. ***\n";
+    homeSpan.addConfig(SpanConfigRecord::MISSING_SERVICE,"AccessoryInformation");
+    homeSpan.addConfigNote(" *** ERROR!  Required Service for this Accessory not found. ***");
     homeSpan.nFatalErrors++;
   }    
 
   if(!foundProtocol && (aid==1 || !homeSpan.isBridge)){           // HAPProtocolInformation must always be present in Accessory if aid=1, and any other Accessory if the device is not a bridge)
-    homeSpan.configLog+="   \u2718 Service HAPProtocolInformation";
-    homeSpan.configLog+=" *** ERROR!  Required Service for this Accessory not found. ***\n";
+    homeSpan.addConfig(SpanConfigRecord::MISSING_SERVICE,"HAPProtocolInformation");
+    homeSpan.addConfigNote(" *** ERROR!  Required Service for this Accessory not found. ***");
     homeSpan.nFatalErrors++;
   }    
 }
@@ -1437,34 +2202,47 @@ int SpanAccessory::sprintfAttributes(char *cBuf){
 //       SpanService         //
 ///////////////////////////////
 
-SpanService::SpanService(const char *type, const char *hapName){
+SpanService::SpanService(const char *type, const char *hapName) : SpanService(type,hapTypeNum(type),hapName){
+}
+
+///////////////////////////////
+
+SpanService::SpanService(const char *type, uint32_t typeNum, const char *hapName, HapSchema schema){
 
   if(!homeSpan.Accessories.empty() && !homeSpan.Accessories.back()->Services.empty())      // this is not the first Service to be defined for this Accessory
     homeSpan.Accessories.back()->Services.back()->validate();    
 
   this->type=type;
+  this->typeNum=typeNum;
   this->hapName=hapName;
+  this->schema=schema;
 
-  homeSpan.configLog+="   \u279f Service " + String(hapName);
-  
   if(homeSpan.Accessories.empty()){
-    homeSpan.configLog+=" *** ERROR!  Can't create new Service without a defined Accessory! ***\n";
+    homeSpan.addConfig(SpanConfigRecord::SERVICE,this,SpanConfigRecord::ORPHAN);
+    homeSpan.addConfigNote(" *** ERROR!  Can't create new Service without a defined Accessory! ***");
     homeSpan.nFatalErrors++;
     return;
   }
 
   homeSpan.Accessories.back()->Services.push_back(this);  
   iid=++(homeSpan.Accessories.back()->iidCount);  
+  aid=homeSpan.Accessories.back()->aid;
 
-  homeSpan.configLog+=":  IID=" + String(iid) + ", UUID=0x" + String(type);
+  homeSpan.addConfig(SpanConfigRecord::SERVICE,this);
 
-  if(!strcmp(this->type,"3E") && iid!=1){
-    homeSpan.configLog+=" *** ERROR!  The AccessoryInformation Service must be defined before any other Services in an Accessory. ***";
+  if(typeNum==0x3E && iid!=1){
+    homeSpan.addConfigNote(" *** ERROR!  The AccessoryInformation Service must be defined before any other Services in an Accessory. ***");
     homeSpan.nFatalErrors++;
   }
 
-  homeSpan.configLog+="\n";
+}
+
+///////////////////////////////
+
+SpanService::~SpanService(){
 
+  for(int i=0;i<Characteristics.size();i++)
+    delete Characteristics[i];
 }
 
 ///////////////////////////////
@@ -1528,46 +2306,68 @@ int SpanService::sprintfAttributes(char *cBuf){
 
 void SpanService::validate(){
 
-  for(int i=0;i<req.size();i++){
-    boolean valid=false;
-    for(int j=0;!valid && j<Characteristics.size();j++)
-      valid=!strcmp(req[i]->type,Characteristics[j]->type);
-      
-    if(!valid){
-      homeSpan.configLog+="      \u2718 Characteristic " + String(req[i]->hapName);
-      homeSpan.configLog+=" *** WARNING!  Required Characteristic for this Service not found. ***\n";
+  HapMask missing=schema.req.without(present);       // required Characteristics not yet added to this Service
+
+  for(int i=0;!missing.empty() && i<HapCharacteristics::N_CHARS;i++){
+    if(missing.test(i)){
+      homeSpan.addConfig(SpanConfigRecord::MISSING_CHARACTERISTIC,hapChars.get(i));
+      homeSpan.addConfigNote(" *** WARNING!  Required Characteristic for this Service not found. ***");
       homeSpan.nWarnings++;
     }
   }
+}
+
+///////////////////////////////
+//         hapTypeNum        //
+///////////////////////////////
+
+uint32_t hapTypeNum(const char *type){
+
+  char *p;
+  uint32_t n=strtoul(type,&p,16);
+  
+  if(*p=='\0')                                          // short-form type
+    return(n);
+
+  if(!strcasecmp(p,"-0000-1000-8000-0026BB765291"))     // full UUID based on HAP Base UUID (HAP Section 6.6.1)
+    return(n);
 
-  vector<HapChar *>().swap(opt);
-  vector<HapChar *>().swap(req);
+  return(0);                                            // custom UUID
 }
 
 ///////////////////////////////
 //    SpanCharacteristic     //
 ///////////////////////////////
 
-SpanCharacteristic::SpanCharacteristic(HapChar *hapChar){
-  type=hapChar->type;
-  perms=hapChar->perms;
-  hapName=hapChar->hapName;
-  format=hapChar->format;
-  staticRange=hapChar->staticRange;
-
-  homeSpan.configLog+="      \u21e8 Characteristic " + String(hapName);
+SpanCharacteristic::SpanCharacteristic(const HapChar *hapChar){
+  this->hapChar=hapChar;
+  index=hapChars.indexOf(hapChar);
+  slot=homeSpan.charStore.add(this,hapChar->format,hapChar->perms);
 
   if(homeSpan.Accessories.empty() || homeSpan.Accessories.back()->Services.empty()){
-    homeSpan.configLog+=" *** ERROR!  Can't create new Characteristic without a defined Service! ***\n";
+    homeSpan.addConfig(SpanConfigRecord::CHARACTERISTIC,this,SpanConfigRecord::ORPHAN);
+    homeSpan.addConfigNote(" *** ERROR!  Can't create new Characteristic without a defined Service! ***");
     homeSpan.nFatalErrors++;
     return;
   }
 
-  iid=++(homeSpan.Accessories.back()->iidCount);
+  iid()=++(homeSpan.Accessories.back()->iidCount);
   service=homeSpan.Accessories.back()->Services.back();
-  aid=homeSpan.Accessories.back()->aid;
+  aid()=homeSpan.Accessories.back()->aid;
+}
+
+///////////////////////////////
+
+SpanCharacteristic::~SpanCharacteristic(){
+
+  if(hapChar->format==FORMAT::STRING){
+    HeapTag::free(HeapTag::DATABASE,value().STRING);
+    if(newValue.STRING!=value().STRING)                 // value and newValue share the same string once an update has been applied
+      HeapTag::free(HeapTag::DATABASE,newValue.STRING);
+  }
 
-  ev=(boolean *)calloc(homeSpan.maxConnections,sizeof(boolean));
+  HeapTag::free(HeapTag::DATABASE,customRange);
+  homeSpan.charStore.remove(slot);
 }
 
 ///////////////////////////////
@@ -1579,26 +2379,29 @@ int SpanCharacteristic::sprintfAttributes(char *cBuf, int flags){
 
   const char formatCodes[][8]={"bool","uint8","uint16","uint32","uint64","int","float","string"};
 
-  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"iid\":%d",iid);
+  SpanCharStore &store=homeSpan.charStore;
+  uint8_t perms=store.perms[slot];
+
+  nBytes+=snprintf(cBuf,cBuf?64:0,"{\"iid\":%d",store.iid[slot]);
 
   if(flags&GET_TYPE)  
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"type\":\"%s\"",type);
+    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"type\":\"%s\"",hapChar->type);
 
   if(perms&PR){    
     if(perms&NV && !(flags&GET_NV))
       nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":null");
     else
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%s",uvPrint(value).c_str());      
+      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"value\":%s",uvPrint(store.value[slot]).c_str());      
   }
 
   if(flags&GET_META){
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"format\":\"%s\"",formatCodes[format]);
+    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"format\":\"%s\"",formatCodes[store.format[slot]]);
     
-    if(customRange && (flags&GET_META)){
-      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"minValue\":%s,\"maxValue\":%s",uvPrint(minValue).c_str(),uvPrint(maxValue).c_str());
+    if(customRange && !initRange && (flags&GET_META)){
+      nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"minValue\":%s,\"maxValue\":%s",uvPrint(customRange[0]).c_str(),uvPrint(customRange[1]).c_str());
         
-      if(uvGet<float>(stepValue)>0)
-        nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"minStep\":%s",uvPrint(stepValue).c_str());
+      if(uvGet<float>(customRange[2])>0)
+        nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?128:0,",\"minStep\":%s",uvPrint(customRange[2]).c_str());
     }
   }
     
@@ -1619,10 +2422,10 @@ int SpanCharacteristic::sprintfAttributes(char *cBuf, int flags){
   }
 
   if(flags&GET_AID)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"aid\":%u",aid);
+    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"aid\":%u",store.aid[slot]);
   
   if(flags&GET_EV)
-    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"ev\":%s",ev[HAPClient::conNum]?"true":"false");
+    nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,",\"ev\":%s",(store.ev[slot]&((uint32_t)1<<HAPClient::conNum))?"true":"false");
 
   nBytes+=snprintf(cBuf?(cBuf+nBytes):NULL,cBuf?64:0,"}");
 
@@ -1643,26 +2446,29 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
     else
       return(StatusCode::InvalidValue);
     
-    if(evFlag && !(perms&EV))         // notification is not supported for characteristic
+    if(evFlag && !(perms()&EV))         // notification is not supported for characteristic
       return(StatusCode::NotifyNotAllowed);
       
     LOG1("Notification Request for aid=");
-    LOG1(aid);
+    LOG1(aid());
     LOG1(" iid=");
-    LOG1(iid);
+    LOG1(iid());
     LOG1(": ");
     LOG1(evFlag?"true":"false");
     LOG1("\n");
-    this->ev[HAPClient::conNum]=evFlag;
+    if(evFlag)
+      this->ev()|=((uint32_t)1<<HAPClient::conNum);
+    else
+      this->ev()&=~((uint32_t)1<<HAPClient::conNum);
   }
 
   if(!val)                // no request to update value
     return(StatusCode::OK);
   
-  if(!(perms&PW))         // cannot write to read only characteristic
+  if(!(perms()&PW))         // cannot write to read only characteristic
     return(StatusCode::ReadOnly);
 
-  switch(format){
+  switch(format()){
     
     case BOOL:
       if(!strcmp(val,"0") || !strcmp(val,"false"))
@@ -1704,7 +2510,7 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
       break;
 
     case STRING:
-      newValue.STRING = (char *)realloc(newValue.STRING, strlen(val) + 1);
+      newValue.STRING = (char *)HeapTag::realloc(HeapTag::DATABASE, newValue.STRING, strlen(val) + 1);
       strncpy(newValue.STRING, val, strlen(val));
       newValue.STRING[strlen(val)] = '\0';
 
@@ -1722,11 +2528,61 @@ StatusCode SpanCharacteristic::loadUpdate(char *val, char *ev){
 
 ///////////////////////////////
 
+void SpanCharacteristic::getNvsKey(char *key){
+  uint16_t t=hapChar->typeNum?hapChar->typeNum:strtoul(hapChar->type,NULL,16);      // custom types use leading hex digits of their UUID, as they always have, so previously stored values are found
+  sprintf(key,"%04X%08X%03X",t,aid(),iid()&0xFFF);
+}
+
+///////////////////////////////
+
 unsigned long SpanCharacteristic::timeVal(){
   
   return(homeSpan.snapTime-updateTime);
 }
 
+///////////////////////////////
+//      SpanCharStore        //
+///////////////////////////////
+
+int SpanCharStore::add(SpanCharacteristic *c, uint8_t format, uint8_t perms){
+
+  aid.push_back(0);
+  iid.push_back(0);
+  this->format.push_back(format);
+  this->perms.push_back(perms);
+  ev.push_back(0);
+  value.push_back(UVal());
+  chr.push_back(c);
+
+  return(chr.size()-1);
+}
+
+///////////////////////////////
+
+void SpanCharStore::remove(int slot){
+
+  int last=chr.size()-1;
+
+  if(slot!=last){                     // move last slot into the one being removed
+    aid[slot]=aid[last];
+    iid[slot]=iid[last];
+    format[slot]=format[last];
+    perms[slot]=perms[last];
+    ev[slot]=ev[last];
+    value[slot]=value[last];
+    chr[slot]=chr[last];
+    chr[slot]->slot=slot;
+  }
+
+  aid.pop_back();
+  iid.pop_back();
+  format.pop_back();
+  perms.pop_back();
+  ev.pop_back();
+  value.pop_back();
+  chr.pop_back();
+}
+
 ///////////////////////////////
 //        SpanRange          //
 ///////////////////////////////
@@ -1734,7 +2590,8 @@ unsigned long SpanCharacteristic::timeVal(){
 SpanRange::SpanRange(int min, int max, int step){
 
   if(homeSpan.Accessories.empty() || homeSpan.Accessories.back()->Services.empty() || homeSpan.Accessories.back()->Services.back()->Characteristics.empty() ){
-    homeSpan.configLog+="    \u2718 SpanRange: *** ERROR!  Can't create new Range without a defined Characteristic! ***\n";
+    homeSpan.addConfig(SpanConfigRecord::ORPHAN_RANGE,NULL);
+    homeSpan.addConfigNote(" *** ERROR!  Can't create new Range without a defined Characteristic! ***");
     homeSpan.nFatalErrors++;
   } else {
     homeSpan.Accessories.back()->Services.back()->Characteristics.back()->setRange(min,max,step);
@@ -1747,10 +2604,14 @@ SpanRange::SpanRange(int min, int max, int step){
 
 SpanButton::SpanButton(int pin, uint16_t longTime, uint16_t singleTime, uint16_t doubleTime){
 
-  homeSpan.configLog+="      \u25bc SpanButton: Pin=" + String(pin) + ", Single=" + String(singleTime) + "ms, Double=" + String(doubleTime) + "ms, Long=" + String(longTime) + "ms";
+  this->pin=pin;
+  this->longTime=longTime;
+  this->singleTime=singleTime;
+  this->doubleTime=doubleTime;
 
   if(homeSpan.Accessories.empty() || homeSpan.Accessories.back()->Services.empty()){
-    homeSpan.configLog+=" *** ERROR!  Can't create new PushButton without a defined Service! ***\n";
+    homeSpan.addConfig(SpanConfigRecord::BUTTON,this,SpanConfigRecord::ORPHAN);
+    homeSpan.addConfigNote(" *** ERROR!  Can't create new PushButton without a defined Service! ***");
     homeSpan.nFatalErrors++;
     return;
   }
@@ -1759,23 +2620,365 @@ SpanButton::SpanButton(int pin, uint16_t longTime, uint16_t singleTime, uint16_t
   Serial.print(pin);
   Serial.print("\n");
 
-  this->pin=pin;
-  this->longTime=longTime;
-  this->singleTime=singleTime;
-  this->doubleTime=doubleTime;
   service=homeSpan.Accessories.back()->Services.back();
+  homeSpan.addConfig(SpanConfigRecord::BUTTON,this);
 
   if((void(*)(int,int))(service->*(&SpanService::button))==(void(*)(int,int))(&SpanService::button)){
-    homeSpan.configLog+=" *** WARNING:  No button() method defined for this PushButton! ***";
+    homeSpan.addConfigNote(" *** WARNING:  No button() method defined for this PushButton! ***");
     homeSpan.nWarnings++;
   }
 
   pushButton=new PushButton(pin);         // create underlying PushButton
   
-  homeSpan.configLog+="\n";  
   homeSpan.PushButtons.push_back(this);
 }
 
+///////////////////////////////
+
+SpanButton::~SpanButton(){
+
+  if(pushButton){
+    detachInterrupt(pin);
+    delete pushButton;
+  }
+}
+
+///////////////////////////////
+//     SpanTimedWrites       //
+///////////////////////////////
+
+void SpanTimedWrites::add(uint64_t pid, uint32_t alarm){
+
+  for(int i=0;i<nTW;i++){
+    if(tw[i].pid==pid){                 // PID already stored - update alarm and restore heap order
+      tw[i].alarm=alarm;
+      siftUp(i);
+      siftDown(i);
+      return;
+    }
+  }
+
+  if(nTW==MAX_TIMED_WRITES)             // no room - drop PID closest to expiring
+    pop();
+
+  tw[nTW].pid=pid;
+  tw[nTW].alarm=alarm;
+  siftUp(nTW++);
+}
+
+///////////////////////////////
+
+int SpanTimedWrites::check(uint64_t pid, uint32_t cTime){
+
+  for(int i=0;i<nTW;i++){
+    if(tw[i].pid==pid)
+      return(before(tw[i].alarm,cTime)?-1:1);
+  }
+
+  return(0);
+}
+
+///////////////////////////////
+
+int SpanTimedWrites::expire(uint32_t cTime){
+
+  int n=0;
+
+  while(nTW>0 && before(tw[0].alarm,cTime)){      // only the head of the heap needs to be checked
+    pop();
+    n++;
+  }
+
+  return(n);
+}
+
+///////////////////////////////
+
+void SpanTimedWrites::pop(){
+
+  tw[0]=tw[--nTW];
+  siftDown(0);
+}
+
+///////////////////////////////
+
+void SpanTimedWrites::siftUp(int i){
+
+  while(i>0){
+    int parent=(i-1)/2;
+    if(!before(tw[i].alarm,tw[parent].alarm))
+      return;
+    tw_t t=tw[i];
+    tw[i]=tw[parent];
+    tw[parent]=t;
+    i=parent;
+  }
+}
+
+///////////////////////////////
+
+void SpanTimedWrites::siftDown(int i){
+
+  while(1){
+    int child=2*i+1;
+    if(child>=nTW)
+      return;
+    if(child+1<nTW && before(tw[child+1].alarm,tw[child].alarm))
+      child++;
+    if(!before(tw[child].alarm,tw[i].alarm))
+      return;
+    tw_t t=tw[i];
+    tw[i]=tw[child];
+    tw[child]=t;
+    i=child;
+  }
+}
+
+///////////////////////////////
+//        SpanStats          //
+///////////////////////////////
+
+const char *SpanStats::routeNames[N_ROUTES]={"pair-setup","pair-verify","pairings","get-accessories","get-characteristics","put-characteristics","put-prepare","event-notify"};
+
+///////////////////////////////
+
+void SpanStats::record(route_t route, uint32_t startTime){
+
+  uint32_t t=micros()-startTime;
+
+  latency[route].add(t);
+
+  if(!firstResponse && route!=EVENT_NOTIFY)
+    firstResponse=millis();
+
+  LOG_EVENT(REQUEST,route==EVENT_NOTIFY?0xFF:HAPClient::conNum,route,t,0);
+}
+
+///////////////////////////////
+
+void SpanStats::print(){
+
+  char d[]="------------------------------";
+  Serial.printf("%-20s  %8s  %8s  %8s  %8s  %8s  %8s\n","Route","Count","Mean","p50","p90","p99","Max");
+  Serial.printf("%.20s  %.8s  %.8s  %.8s  %.8s  %.8s  %.8s\n",d,d,d,d,d,d,d);
+  
+  for(int i=0;i<N_ROUTES;i++){
+    Histogram *h=latency+i;
+    Serial.printf("%-20s  %8u  %8u  %8u  %8u  %8u  %8u\n",routeNames[i],h->count(),h->mean(),h->percentile(50),h->percentile(90),h->percentile(99),h->largest());
+  }
+
+  Serial.print("\nAll times in microseconds.\n\n");
+  Serial.printf("Bad Requests: %u   Not Found: %u   Events Sent: %u   Bytes Sent: %llu\n",nBadRequests,nNotFound,nEvents,nBytesSent);
+
+  if(firstResponse)
+    Serial.printf("First HAP Response: %u ms after boot (Database Ready at %lu ms)\n",firstResponse,homeSpan.readyTime);
+}
+
+///////////////////////////////
+
+int SpanStats::sprintfJSON(char *cBuf){
+
+  int nChars=0;
+
+  nChars+=snprintf(cBuf,cBuf?256:0,"{\"uptime\":%llu,\"firstResponse\":%u,\"badRequests\":%u,\"notFound\":%u,\"events\":%u,\"bytesSent\":%llu,\"routes\":{",
+                   esp_timer_get_time()/1000000,firstResponse,nBadRequests,nNotFound,nEvents,nBytesSent);
+
+  for(int i=0;i<N_ROUTES;i++){
+    Histogram *h=latency+i;
+    nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?256:0,"\"%s\":{\"n\":%u,\"mean\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}%s",
+                     routeNames[i],h->count(),h->mean(),h->percentile(50),h->percentile(90),h->percentile(99),h->largest(),i<N_ROUTES-1?",":"");
+  }
+
+  nChars+=snprintf(cBuf?(cBuf+nChars):NULL,cBuf?64:0,"}}");
+
+  return(nChars);
+}
+
+///////////////////////////////
+
+void SpanStats::reset(){
+
+  for(int i=0;i<N_ROUTES;i++)
+    latency[i].reset();
+
+  nBadRequests=0;
+  nNotFound=0;
+  nEvents=0;
+  nBytesSent=0;
+}
+
+///////////////////////////////
+//        SpanBudget         //
+///////////////////////////////
+
+const int SpanBudget::ACCESSORY_BYTES=sizeof(SpanAccessory)+TAG_OVERHEAD+2*sizeof(SpanAccessory *)+3*sizeof(void *)+HEAP_OVERHEAD;     // vector slots allow for capacity doubling; aids adds a node (next pointer and aid) and a bucket pointer
+const int SpanBudget::SERVICE_BYTES=sizeof(SpanService)+TAG_OVERHEAD+2*sizeof(SpanService *);
+const int SpanBudget::CHARACTERISTIC_BYTES=sizeof(SpanCharacteristic)+TAG_OVERHEAD+2*sizeof(SpanCharacteristic *)+sizeof(uint64_t)+sizeof(SpanCharacteristic *)+2*SpanCharStore::SLOT_BYTES;
+const int SpanBudget::CONNECTION_BYTES=sizeof(HAPClient)+TAG_OVERHEAD;
+
+///////////////////////////////
+
+void SpanBudget::compute(){
+
+  nAccessories=homeSpan.Accessories.size();
+  nServices=0;
+  nCharacteristics=0;
+
+  for(int i=0;i<nAccessories;i++){
+    nServices+=homeSpan.Accessories[i]->Services.size();
+    for(int j=0;j<homeSpan.Accessories[i]->Services.size();j++)
+      nCharacteristics+=homeSpan.Accessories[i]->Services[j]->Characteristics.size();
+  }
+
+  databaseBytes=nAccessories*ACCESSORY_BYTES+nServices*SERVICE_BYTES+nCharacteristics*CHARACTERISTIC_BYTES;
+  jsonBytes=homeSpan.sprintfAttributes(NULL);
+  peakBytes=homeSpan.maxConnections*CONNECTION_BYTES+3*(jsonBytes+TAG_OVERHEAD)+HAPClient::MAX_TX_QUEUE;
+
+  freeBytes=heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  largestBlock=heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+///////////////////////////////
+
+int SpanBudget::maxAccessories(){
+
+  if(nAccessories==0)
+    return(HAPClient::MAX_ACCESSORIES);
+
+  size_t perAccessory=(databaseBytes+3*jsonBytes)/nAccessories;        // each Accessory costs its own objects plus its share of the three copies of the /accessories response
+  size_t fixedBytes=peakBytes-3*jsonBytes;
+  size_t total=databaseBytes+freeBytes;                                // heap that was available before the database was built
+
+  if(total<=fixedBytes)
+    return(0);
+
+  int n=(total-fixedBytes)/perAccessory;
+  return(n<HAPClient::MAX_ACCESSORIES?n:HAPClient::MAX_ACCESSORIES);
+}
+
+///////////////////////////////
+
+void SpanBudget::print(){
+
+  char d[]="------------------------------";
+
+  Serial.print("\nMemory Budget (estimated):\n\n");
+  Serial.printf("%-16s  %6s  %10s  %10s\n","Object","Count","Bytes Each","Total");
+  Serial.printf("%.16s  %.6s  %.10s  %.10s\n",d,d,d,d);
+  Serial.printf("%-16s  %6d  %10d  %10d\n","Accessories",nAccessories,ACCESSORY_BYTES,nAccessories*ACCESSORY_BYTES);
+  Serial.printf("%-16s  %6d  %10d  %10d\n","Services",nServices,SERVICE_BYTES,nServices*SERVICE_BYTES);
+  Serial.printf("%-16s  %6d  %10d  %10d\n","Characteristics",nCharacteristics,CHARACTERISTIC_BYTES,nCharacteristics*CHARACTERISTIC_BYTES);
+  Serial.printf("%-16s  %6d  %10d  %10d\n","Connections",homeSpan.maxConnections,CONNECTION_BYTES,homeSpan.maxConnections*CONNECTION_BYTES);
+  Serial.printf("%.16s  %.6s  %.10s  %.10s\n",d,d,d,d);
+  Serial.printf("%-30s  %10u\n","/accessories JSON",jsonBytes);
+  Serial.printf("%-30s  %10u\n","Run-Time Peak",peakBytes);
+  Serial.printf("%-30s  %10u\n","Free Heap",freeBytes);
+  Serial.printf("%-30s  %10u\n","Largest Free Block",largestBlock);
+  Serial.printf("%-30s  %10d  %s\n","Max Accessories",maxAccessories(),fits()?"":"*** INSUFFICIENT MEMORY ***");
+}
+
+///////////////////////////////
+//        SpanMemory         //
+///////////////////////////////
+
+const char *SpanMemory::phaseNames[N_PHASES]={"pair-setup","accessories"};
+
+///////////////////////////////
+
+void SpanMemory::start(phase_t p){
+  phases[p].startFree=heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  phases[p].startLowest=heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+///////////////////////////////
+
+void SpanMemory::stop(phase_t p){
+
+  phase *ph=phases+p;
+  size_t lowest=heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  size_t minFree=heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+  if(lowest<ph->startLowest)          // a new lifetime low was reached during this run, so it is the exact low point of this run
+    minFree=lowest;                   // otherwise, the free heap at the end of the run is the best available estimate
+
+  if(minFree<ph->startFree && ph->startFree-minFree>ph->highWater)
+    ph->highWater=ph->startFree-minFree;
+  
+  ph->count++;
+}
+
+///////////////////////////////
+
+void SpanMemory::print(){
+
+  char d[]="------------------------------";
+  size_t total=0;
+
+  Serial.print("\n*** Heap Usage ***\n\n");
+  Serial.printf("%-16s  %8s  %10s  %10s  %10s\n","Subsystem","Allocs","Bytes","Peak Bytes","Cumulative");
+  Serial.printf("%.16s  %.8s  %.10s  %.10s  %.10s\n",d,d,d,d,d);
+
+  for(int i=0;i<HeapTag::N_TAGS;i++){
+    HeapTag::usage_t *u=HeapTag::usage+i;
+    Serial.printf("%-16s  %8u  %10u  %10u  %10u\n",HeapTag::names[i],u->nAllocs,u->bytes,u->peak,u->nTotal);
+    total+=u->bytes;
+  }
+
+  int nMpis;
+  size_t mpiBytes=HAPClient::srp.mpiBytes(&nMpis);
+  size_t notifyBytes=homeSpan.Notifications.capacity()*sizeof(SpanBuf);
+  size_t logBytes=homeSpan.configLog.capacity()*sizeof(SpanConfigRecord);
+
+  Serial.printf("%-16s  %8u  %10u  %10s  %10s\n","SRP Bignums",nMpis,mpiBytes,"-","-");
+  Serial.printf("%-16s  %8u  %10u  %10s  %10s\n","Config Log",logBytes?1:0,logBytes,"-","-");
+  Serial.printf("%-16s  %8u  %10u  %10s  %10s\n","Notifications",notifyBytes?1:0,notifyBytes,"-","-");
+  Serial.printf("%-16s  %8s  %10u  %10s  %10s\n","HTTP/TLV Buffer","static",sizeof(HAPClient::httpBuf),"-","-");
+  Serial.printf("%.16s  %.8s  %.10s  %.10s  %.10s\n",d,d,d,d,d);
+  Serial.printf("%-16s  %8s  %10u\n","Total","",total+mpiBytes+logBytes+notifyBytes+sizeof(HAPClient::httpBuf));
+
+  Serial.printf("\n%-16s  %8s  %10s\n","Phase","Runs","High-Water");
+  Serial.printf("%.16s  %.8s  %.10s\n",d,d,d);
+  for(int i=0;i<N_PHASES;i++)
+    Serial.printf("%-16s  %8u  %10u\n",phaseNames[i],phases[i].count,phases[i].highWater);
+
+  Serial.printf("\nFree Heap:        %u bytes (%u minimum, %u largest block)\n",heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  Serial.printf("Free PSRAM:       %u bytes\n\n",heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
+
+///////////////////////////////
+//       SpanLogRing         //
+///////////////////////////////
+
+#if HOMESPAN_LOG_RING>0
+
+const char *SpanLogRing::eventNames[]={"CONNECT","EVICT","REAP","DISCONNECT","REQUEST","HTTP-ERROR","SLOW-CONSUMER","STALL"};
+
+///////////////////////////////
+
+void SpanLogRing::drain(){
+
+  const int maxLine=96;                                   // maximum length of a decoded event
+
+  if(head-tail>HOMESPAN_LOG_RING && Serial.availableForWrite()>=maxLine){      // oldest events were overwritten before they could be decoded
+    Serial.printf("[LOG] %u events dropped\n",head-tail-HOMESPAN_LOG_RING);
+    tail=head-HOMESPAN_LOG_RING;
+  }
+  
+  while(tail!=head && Serial.availableForWrite()>=maxLine){
+    entry_t *e=ring+(tail++%HOMESPAN_LOG_RING);
+    
+    Serial.printf("[LOG %u.%06u] %s",e->time/1000000,e->time%1000000,eventNames[e->type]);
+    if(e->slot!=0xFF)
+      Serial.printf(" #%u",e->slot);
+    if(e->type==REQUEST)
+      Serial.printf(" %s %u us\n",SpanStats::routeNames[e->code],e->a);
+    else
+      Serial.printf(" code=%u a=%u b=%u\n",e->code,e->a,e->b);
+  }
+}
+
+#endif
 
 ///////////////////////////////
 //     SpanUserCommand       //
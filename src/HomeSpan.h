@@ -33,6 +33,7 @@
 
 #include <Arduino.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <nvs.h>
 
 #include "Settings.h"
@@ -44,6 +45,7 @@
 
 using std::vector;
 using std::unordered_map;
+using std::unordered_set;
 
 enum {
   GET_AID=1,
@@ -71,6 +73,40 @@ struct SpanUserCommand;
 
 extern Span homeSpan;
 
+uint32_t hapTypeNum(const char *type);     // returns short-form numeric type from either a short-form type string (e.g. "3E") or a full 128-bit UUID based on the HAP Base UUID; returns 0 for any other (custom) UUID
+
+///////////////////////////////
+
+union UVal {                                  // value of a Characteristic, in the FORMAT specified by its HapChar
+  boolean BOOL;
+  uint8_t UINT8;
+  uint16_t UINT16;
+  uint32_t UINT32;
+  uint64_t UINT64;
+  int32_t INT;
+  double FLOAT;
+  char *STRING = NULL;
+};
+
+///////////////////////////////
+
+struct SpanCharStore {                        // packed store of the Characteristic attributes read on every HAP request, kept in contiguous arrays indexed by each Characteristic's slot number (all other attributes remain in the SpanCharacteristic itself)
+
+  vector<uint32_t> aid;                       // Accessory ID
+  vector<int> iid;                            // Instance ID
+  vector<uint8_t> format;                     // FORMAT (copied from HapChar)
+  vector<uint8_t> perms;                      // PERMS (copied from HapChar)
+  vector<uint32_t> ev;                        // Event Notify Enable (one bit per connection slot)
+  vector<UVal> value;                         // Characteristic Value
+  vector<SpanCharacteristic *> chr;           // Characteristic that owns each slot
+
+  static const int SLOT_BYTES=2*sizeof(uint32_t)+sizeof(int)+2*sizeof(uint8_t)+sizeof(UVal)+sizeof(SpanCharacteristic *);     // bytes used by each slot across all arrays
+
+  int add(SpanCharacteristic *c, uint8_t format, uint8_t perms);      // adds a slot for Characteristic c (with aid, iid, ev, and value cleared); returns slot number
+  void remove(int slot);                      // removes slot by moving the last slot into its place (and updating the slot number of the Characteristic that owns it), so slots remain dense
+  int size(){return(chr.size());}             // returns number of slots
+};
+
 ///////////////////////////////
 
 struct SpanConfig {                         
@@ -80,6 +116,197 @@ struct SpanConfig {
 
 ///////////////////////////////
 
+struct SpanSnapshot {                         // identifies the build and structure of the Span Database when hashCode was last verified, so that re-hashing the full JSON database can be skipped at start-up when neither has changed
+  uint8_t elfHash[32]={0};                    // SHA-256 hash of the sketch's ELF file, as embedded in the app description by the build
+  uint64_t fingerprint=0;                     // FNV-1a hash of the structure of the Span Database (IDs, types, permissions, formats, ranges, and the values of all STRING and non-EV Characteristics), as computed by Span::fingerprint()
+};
+
+///////////////////////////////
+
+struct SpanTimedWrites {                      // fixed-capacity store of Timed Write PIDs (HAP Section 6.7.2.4), kept as a min-heap ordered by alarm time
+
+  static const int MAX_TIMED_WRITES=16;       // maximum number of pending PIDs - when full, the PID closest to expiring is dropped to make room for a new one
+
+  struct tw_t {
+    uint64_t pid;                             // PID provided by Controller in PUT /prepare
+    uint32_t alarm;                           // time (in millis) after which PID expires
+  };
+
+  tw_t tw[MAX_TIMED_WRITES];                  // heap of PIDs (tw[0] always has the earliest alarm)
+  int nTW=0;                                  // number of PIDs stored
+
+  static boolean before(uint32_t a, uint32_t b){return((int32_t)(a-b)<0);}     // returns true if time a is earlier than time b (safe across millis() rollover)
+
+  void add(uint64_t pid, uint32_t alarm);     // adds PID with specified alarm time, or updates alarm time if PID already stored
+  int check(uint64_t pid, uint32_t cTime);    // returns 1 if PID is stored and has not expired as of cTime, -1 if PID is stored but has expired, or 0 if PID is not found
+  int expire(uint32_t cTime);                 // removes all PIDs that have expired as of cTime; returns number of PIDs removed
+  boolean empty(){return(nTW==0);}            // returns true if there are no PIDs stored
+  uint32_t nextAlarm(){return(tw[0].alarm);}  // returns earliest alarm time (only valid if not empty)
+  void pop();                                 // removes PID with earliest alarm time
+  void siftUp(int i);                         // restores heap order by moving element i up
+  void siftDown(int i);                       // restores heap order by moving element i down
+};
+
+///////////////////////////////
+
+struct SpanStats {                            // low-overhead counters and latency histograms for each HAP route, reported with the 'p' and 'P' CLI commands
+
+  enum route_t {
+    PAIR_SETUP,
+    PAIR_VERIFY,
+    PAIRINGS,
+    GET_ACCESSORIES,
+    GET_CHARACTERISTICS,
+    PUT_CHARACTERISTICS,
+    PUT_PREPARE,
+    EVENT_NOTIFY,
+    N_ROUTES
+  };
+
+  static const char *routeNames[N_ROUTES];    // names of each route, as used in the JSON report
+
+  Histogram latency[N_ROUTES];                // latency (in microseconds) of each request from receipt to response, or of each Event Notification fan-out to all clients
+  uint32_t nBadRequests=0;                    // number of requests answered with 400 Bad Request
+  uint32_t nNotFound=0;                       // number of requests answered with 404 Not Found
+  uint32_t nEvents=0;                         // number of Event Notification messages sent (one per client notified)
+  uint64_t nBytesSent=0;                      // number of bytes written (sent or queued) to all HAP clients
+  uint32_t firstResponse=0;                   // time (in millis after boot) at which the first HAP request was answered (0=none yet) - not cleared by reset()
+
+  void record(route_t route, uint32_t startTime);     // records latency of route, given its start time (in micros)
+  void print();                               // prints table of counters and latency percentiles to serial monitor
+  int sprintfJSON(char *cBuf);                // prints counters and latency percentiles as JSON into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
+  void reset();                               // resets all counters and histograms
+};
+
+///////////////////////////////
+
+struct SpanBudget {                           // estimates RAM needed by the HAP Accessory Database at run-time from the actual size of each object, and compares it with available heap (including PSRAM if used by malloc)
+
+  static const int HEAP_OVERHEAD=12;          // approximate number of bytes of bookkeeping the heap allocator adds to each allocation
+  static const int TAG_OVERHEAD=HEAP_OVERHEAD+sizeof(HeapTag::header_t);    // same, for allocations made through HeapTag (which adds a size header)
+  static const int ACCESSORY_BYTES;           // estimated bytes per Accessory (object, allocation overhead, and vector slots)
+  static const int SERVICE_BYTES;             // estimated bytes per Service
+  static const int CHARACTERISTIC_BYTES;      // estimated bytes per Characteristic (including its entries in the lookup index and packed attribute store)
+  static const int CONNECTION_BYTES;          // estimated bytes per HAP connection
+
+  int nAccessories=0;                         // number of Accessories in database
+  int nServices=0;                            // number of Services in database
+  int nCharacteristics=0;                     // number of Characteristics in database
+  size_t databaseBytes=0;                     // estimated bytes used by database objects
+  size_t jsonBytes=0;                         // exact size of the /accessories JSON response
+  size_t peakBytes=0;                         // estimated additional bytes needed at run-time: all connections plus plain, encrypted, and queued copies of the /accessories response
+  size_t freeBytes=0;                         // free heap (including PSRAM if used by malloc)
+  size_t largestBlock=0;                      // largest free contiguous block of heap
+
+  void compute();                             // computes all of the above from the current database and heap
+  boolean fits(){return(peakBytes<=freeBytes && jsonBytes+jsonBytes/32<=largestBlock);}     // returns true if run-time needs fit within available heap (the encrypted response, which adds 18 bytes per 1024-byte frame, is the largest single allocation)
+  int maxAccessories();                       // projected number of Accessories of the current average size that fit within available heap (capped at HAP limit)
+  void print();                               // prints budget to serial monitor
+};
+
+///////////////////////////////
+
+struct SpanMemory {                           // heap usage by subsystem, plus heap high-water marks during the most memory-intensive HAP routes, reported with the 'm' CLI command
+
+  enum phase_t {
+    PAIR_SETUP,
+    GET_ACCESSORIES,
+    N_PHASES
+  };
+
+  static const char *phaseNames[N_PHASES];    // names of each phase, as printed by the 'm' CLI command
+
+  struct phase {
+    uint32_t count=0;                         // number of times phase has run
+    size_t highWater=0;                       // largest drop in free heap (in bytes) observed during any run of phase
+    size_t startFree=0;                       // free heap at start of current run
+    size_t startLowest=0;                     // lifetime minimum free heap at start of current run
+  } phases[N_PHASES];
+
+  void start(phase_t p);                      // marks start of a run of phase p
+  void stop(phase_t p);                       // marks end of a run of phase p, and updates its high-water mark
+  void print();                               // prints heap usage by subsystem (from HeapTag) and high-water marks to serial monitor
+};
+
+///////////////////////////////
+
+struct SpanConfigRecord {                     // compact record of one step in the configuration of the HAP Accessory Database (including any errors), rendered to the serial monitor on demand by Span::printConfig()
+
+  enum kind_t : uint8_t {
+    ACCESSORY,                                // obj=SpanAccessory
+    SERVICE,                                  // obj=SpanService
+    CHARACTERISTIC,                           // obj=SpanCharacteristic
+    RANGE,                                    // obj=SpanCharacteristic whose range was set with setRange()
+    BUTTON,                                   // obj=SpanButton
+    OUT_OF_RANGE,                             // obj=SpanCharacteristic whose initial value is out of range
+    MISSING_SERVICE,                          // obj=name of required Service not found
+    MISSING_CHARACTERISTIC,                   // obj=HapChar of required Characteristic not found
+    ORPHAN_RANGE,                             // obj=NULL (SpanRange created without a Characteristic)
+    NOTE                                      // obj=text of error or warning appended to prior record
+  };
+
+  enum {
+    ORPHAN=1,                                 // Service, Characteristic, or Button was created without a parent, so only its name or settings are shown
+    RESTORED=2,                               // Characteristic value was restored from NVS
+    STORING=4,                                // Characteristic value was stored in NVS for the first time
+    STORED=8,                                 // Characteristic value is saved in NVS (used when records are re-created from the database)
+    FAILED=16                                 // setRange() failed, so no range is shown
+  };
+
+  kind_t kind;                                // kind of record
+  uint8_t flag;                               // flags that modify rendering of record (see above)
+  const void *obj;                            // object being configured, from which all other details are rendered
+};
+
+///////////////////////////////
+
+#if HOMESPAN_LOG_RING>0
+
+struct SpanLogRing {                          // ring of fixed-size binary event records that are cheap to write as events occur, and are only decoded to the serial monitor when there is room to do so without blocking
+
+  enum event_t : uint8_t {
+    CONNECT,                                  // slot=connection, a=IP address
+    EVICT,                                    // slot=connection, a=idle time (seconds)
+    REAP,                                     // slot=connection, a=unacknowledged Event Notifications
+    DISCONNECT,                               // slot=connection
+    REQUEST,                                  // slot=connection, code=SpanStats route, a=latency (microseconds)
+    HTTP_ERROR,                               // slot=connection, code=HTTP status
+    SLOW_CONSUMER,                            // code=socket, a=queued bytes
+    STALL                                     // code=iid, a=aid, b=time (microseconds)
+  };
+
+  static const char *eventNames[];            // names of each event type, as decoded
+
+  struct entry_t {
+    uint32_t time;                            // time (in micros) event was recorded
+    event_t type;                             // type of event
+    uint8_t slot;                             // connection slot (0xFF if not applicable)
+    uint16_t code;                            // event-specific code
+    uint32_t a;                               // event-specific argument
+    uint32_t b;                               // event-specific argument
+  };
+
+  entry_t ring[HOMESPAN_LOG_RING];            // ring of events (oldest events are overwritten when full)
+  uint32_t head=0;                            // total number of events recorded
+  uint32_t tail=0;                            // total number of events decoded or dropped
+
+  void add(event_t type, uint8_t slot, uint16_t code, uint32_t a, uint32_t b){
+    entry_t *e=ring+(head++%HOMESPAN_LOG_RING);
+    e->time=micros();
+    e->type=type;
+    e->slot=slot;
+    e->code=code;
+    e->a=a;
+    e->b=b;
+  }
+
+  void drain();                               // decodes events to the serial monitor for as long as there is room in the Serial transmit buffer
+};
+
+#endif
+
+///////////////////////////////
+
 struct SpanBuf{                               // temporary storage buffer for use with putCharacteristicsURL() and checkTimedResets() 
   uint32_t aid=0;                             // updated aid 
   int iid=0;                                  // updated iid
@@ -103,7 +330,10 @@ struct Span{
   boolean isInitialized=false;                  // flag indicating HomeSpan has been initialized
   int nFatalErrors=0;                           // number of fatal errors in user-defined configuration
   int nWarnings=0;                              // number of warnings errors in user-defined configuration
-  String configLog;                             // log of configuration process, including any errors
+  vector<SpanConfigRecord> configLog;           // records of configuration process, including any errors - discarded once HomeSpan is running, after which printConfig() re-creates them from the database
+  unsigned long readyTime;                      // time (in millis) at which database was ready
+  uint32_t readyHeap;                           // free heap when database was ready
+  uint32_t readyMinHeap;                        // minimum free heap since boot when database was ready
   boolean isBridge=true;                        // flag indicating whether device is configured as a bridge (i.e. first Accessory contains nothing but AccessoryInformation and HAPProtocolInformation)
   HapQR qrCode;                                 // optional QR Code to use for pairing
   const char *sketchVersion="n/a";              // version of the sketch
@@ -118,9 +348,19 @@ struct Span{
   uint8_t statusPin=DEFAULT_STATUS_PIN;                       // pin for status LED    
   uint8_t controlPin=DEFAULT_CONTROL_PIN;                     // pin for Control Pushbutton
   uint8_t logLevel=DEFAULT_LOG_LEVEL;                         // level for writing out log messages to serial monitor
+  size_t logBufferSize=DEFAULT_LOG_BUFFER;                    // size (in bytes) of buffer used to write log messages to serial monitor in the background (0=write directly)
+  boolean logBufferDrop=true;                                 // if true, log messages that do not fit in buffer are discarded; else poll() waits for room
+  static const int MAX_CONNECTIONS=32;                        // upper limit on maxConnections, since per-connection EV notification flags are stored as bits in a 32-bit mask
   uint8_t maxConnections=DEFAULT_MAX_CONNECTIONS;             // number of simultaneous HAP connections
   unsigned long comModeLife=DEFAULT_COMMAND_TIMEOUT*1000;     // length of time (in milliseconds) to keep Command Mode alive before resuming normal operations
   uint16_t tcpPortNum=DEFAULT_TCP_PORT;                       // port for TCP communications between HomeKit and HomeSpan
+  uint32_t pollTimeout=DEFAULT_POLL_TIMEOUT;                  // maximum time (in milliseconds) poll() blocks waiting for new activity when idle (0=never block)
+  uint64_t idleTime=0;                                        // cumulative time (in microseconds) poll() has spent blocked waiting for new activity
+  uint16_t keepAliveIdle=DEFAULT_TCP_KEEPALIVE;               // time (in seconds) a HAP connection is idle before TCP keepalive probes are sent (0=keepalive disabled)
+  uint16_t keepAliveInterval=5;                               // time (in seconds) between TCP keepalive probes
+  uint8_t keepAliveCount=3;                                   // number of unanswered TCP keepalive probes before connection is dropped
+  unsigned long connectionTimeout=DEFAULT_IDLE_TIMEOUT*1000;  // time (in milliseconds) after which a HAP connection that has not sent a request is closed (0=never)
+  uint32_t callbackBudget=DEFAULT_CALLBACK_BUDGET*1000;       // time (in microseconds) a single call to a Service's loop(), button(), or update() method may take before it is logged as a stall (0=never log)
   char qrID[5]="";                                            // Setup ID used for pairing with QR Code
   boolean otaEnabled=false;                                   // enables Over-the-Air ("OTA") updates
   char otaPwd[33];                                            // MD5 Hash of OTA password, represented as a string of hexidecimal characters
@@ -132,14 +372,30 @@ struct Span{
   WiFiServer *hapServer;                            // pointer to the HAP Server connection
   Blinker statusLED;                                // indicates HomeSpan status
   PushButton controlButton;                         // controls HomeSpan configuration and resets
+  SerialLine<16> serialLine;                        // accumulates CLI commands typed into the serial monitor
+  SerialBuffer logBuffer;                           // optional buffer for log messages, written to serial monitor by a background task
+  Print *logOut=&Serial;                            // destination of log messages (either Serial, or logBuffer if enabled)
   Network network;                                  // configures WiFi and Setup Code via either serial monitor or temporary Access Point
     
   SpanConfig hapConfig;                             // track configuration changes to the HAP Accessory database; used to increment the configuration number (c#) when changes found
   vector<SpanAccessory *> Accessories;              // vector of pointers to all Accessories
+  unordered_set<uint32_t> aids;                     // aids of all Accessories, used to detect duplicates without searching Accessories
+  uint32_t maxAid=0;                                // highest aid used since start-up - Accessories added after start-up without an aid count up from here, so an aid that has been deleted is never given to a different Accessory
   vector<SpanService *> Loops;                      // vector of pointer to all Services that have over-ridden loop() methods
   vector<SpanBuf> Notifications;                    // vector of SpanBuf objects that store info for Characteristics that are updated with setVal() and require a Notification Event
   vector<SpanButton *> PushButtons;                 // vector of pointer to all PushButtons
-  unordered_map<uint64_t, uint32_t> TimedWrites;    // map of timed-write PIDs and Alarm Times (based on TTLs)
+  vector<SpanAccessory *> Deleted;                  // Accessories removed from database by deleteAccessory(), but not yet freed by releaseDeleted()
+  boolean loopsChanged=false;                       // set when Accessories are added or deleted after start-up, so that releaseDeleted() rebuilds Loops
+  vector<uint64_t> charKeys;                        // sorted keys (aid in upper 32 bits, iid in lower 32 bits) of all Characteristics, searched by find()
+  vector<SpanCharacteristic *> charIndex;           // pointers to all Characteristics, in the same order as charKeys
+  SpanCharStore charStore;                          // aid, iid, format, perms, ev, and value of all Characteristics, in contiguous arrays
+  SpanTimedWrites TimedWrites;                      // timed-write PIDs and Alarm Times (based on TTLs)
+  SpanStats Stats;                                  // request counters and latency histograms
+  SpanBudget Budget;                                // estimated memory requirements of HAP Accessory Database
+  SpanMemory Memory;                                // heap usage by subsystem and high-water marks
+#if HOMESPAN_LOG_RING>0
+  SpanLogRing logRing;                              // binary event log ring
+#endif
   
   unordered_map<char, SpanUserCommand *> UserCommands;           // map of pointers to all UserCommands
 
@@ -150,19 +406,40 @@ struct Span{
              
   void poll();                                  // poll HAP Clients and process any new HAP requests
   int getFreeSlot();                            // returns free HAPClient slot number. HAPClients slot keep track of each active HAPClient connection
+  int getEvictSlot();                           // returns HAPClient slot to free when all are in use: the least-recently-active unverified connection, else the least-recently-active verified connection
+  void releaseSlot(int slot);                   // deletes HAPClient in slot once its connection has closed, so per-connection keys and buffers only consume memory while a client is connected
+  uint32_t nextDeadline();                      // returns time (in milliseconds) until next scheduled activity, capped at pollTimeout (0=activity is pending now)
+  void idleWait();                              // blocks until a HAP client has data available, or the next scheduled activity is due, whichever comes first
   void checkConnect();                          // check WiFi connection; connect if needed
   void commandMode();                           // allows user to control and reset HomeSpan settings with the control button
   void processSerialCommand(const char *c);     // process command 'c' (typically from readSerial, though can be called with any 'c')
 
+  void addConfig(SpanConfigRecord::kind_t kind, const void *obj, uint8_t flag=0){configLog.push_back({kind,flag,obj});}    // adds record of configuration process
+  void addConfigNote(const char *msg){configLog.push_back({SpanConfigRecord::NOTE,0,msg});}                              // adds error or warning 'msg' (which must be a string literal) to prior record
+  void printConfigRecord(const SpanConfigRecord &r);    // renders record r to serial monitor (without trailing newline)
+  void printConfigRecords();                            // renders all records in configLog to serial monitor
+  void printConfig();                                   // prints configuration log to serial monitor, re-creating it from database if records have been discarded
+
   int sprintfAttributes(char *cBuf);            // prints Attributes JSON database into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
   void prettyPrint(char *buf, int nsp=2);       // print arbitrary JSON from buf to serial monitor, formatted with indentions of 'nsp' spaces
   SpanCharacteristic *find(uint32_t aid, int iid);   // return Characteristic with matching aid and iid (else NULL if not found)
+  void buildIndex();                                 // builds charKeys and charIndex from Accessories database
+  void indexAccessory(SpanAccessory *acc);           // inserts keys of all Characteristics in Accessory acc into charKeys and charIndex, in place
+  void unindexAccessory(uint32_t aid);               // removes keys of all Characteristics in Accessory with matching aid from charKeys and charIndex, in place
+  void buildLoops();                                 // builds Loops from Accessories database
+  void releaseDeleted();                             // frees Accessories removed by deleteAccessory() along with their PushButtons and pending Event Notifications, and rebuilds Loops - called by poll() only when no Service loop() or button() methods are running
+  uint64_t fingerprint();                            // returns FNV-1a hash of structure and static values of Accessories database, computed directly from the database without creating JSON
+  void checkFatalErrors();                           // halts program if any fatal errors were found in configuration
   
   int countCharacteristics(char *buf);                                    // return number of characteristic objects referenced in PUT /characteristics JSON request
   int updateCharacteristics(char *buf, SpanBuf *pObj);                    // parses PUT /characteristics JSON request 'buf into 'pObj' and updates referenced characteristics; returns 1 on success, 0 on fail
   int sprintfAttributes(SpanBuf *pObj, int nObj, char *cBuf);             // prints SpanBuf object into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
   int sprintfAttributes(char **ids, int numIDs, int flags, char *cBuf);   // prints accessory.characteristic ids into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL
 
+  void timeCallback(SpanService *svc, const char *method, uint32_t startTime);     // adds time since startTime (in micros) to cumulative time of svc, and logs a stall if the call to 'method' exceeded callbackBudget
+  void printCallbackTimes();                                              // prints table of time spent in loop(), button(), and update() methods of each Service
+  void resetCallbackTimes();                                              // resets time spent in loop(), button(), and update() methods of all Services
+
   void clearNotify(int slotNum);                                          // set ev notification flags for connection 'slotNum' to false across all characteristics 
   int sprintfNotify(SpanBuf *pObj, int nObj, char *cBuf, int conNum);     // prints notification JSON into buf based on SpanBuf objects and specified connection number
 
@@ -174,9 +451,14 @@ struct Span{
   void setApTimeout(uint16_t nSec){network.lifetime=nSec*1000;}           // sets Access Point Timeout (seconds)
   void setCommandTimeout(uint16_t nSec){comModeLife=nSec*1000;}           // sets Command Mode Timeout (seconds)
   void setLogLevel(uint8_t level){logLevel=level;}                        // sets Log Level for log messages (0=baseline, 1=intermediate, 2=all)
+  void setLogBuffer(size_t nBytes, boolean dropWhenFull=true){logBufferSize=nBytes;logBufferDrop=dropWhenFull;}     // writes log messages to serial monitor in the background through a buffer of nBytes (0=write directly)
   void setMaxConnections(uint8_t nCon){maxConnections=nCon;}              // sets maximum number of simultaneous HAP connections (HAP requires devices support at least 8)
   void setHostNameSuffix(const char *suffix){hostNameSuffix=suffix;}      // sets the hostName suffix to be used instead of the 6-byte AccessoryID
   void setPortNum(uint16_t port){tcpPortNum=port;}                        // sets the TCP port number to use for communications between HomeKit and HomeSpan
+  void setPollTimeout(uint32_t ms){pollTimeout=ms;}                       // sets the maximum time (in milliseconds) poll() blocks waiting for new activity when idle (0=never block)
+  void setConnectionTimeout(uint32_t nSec){connectionTimeout=nSec*1000;}  // sets the time (in seconds) after which a HAP connection that has not sent a request is closed (0=never)
+  void setCallbackBudget(uint32_t ms){callbackBudget=ms*1000;}           // sets the time (in milliseconds) a single call to a Service's loop(), button(), or update() method may take before it is logged as a stall (0=never log)
+  void setTcpKeepAlive(uint16_t idleSec, uint16_t intervalSec=5, uint8_t count=3){keepAliveIdle=idleSec;keepAliveInterval=intervalSec;keepAliveCount=count;}    // enables TCP keepalive probes on HAP connections (idleSec=0 disables)
   void setQRID(const char *id);                                           // sets the Setup ID for optional pairing with a QR Code
   void enableOTA(boolean auth=true){otaEnabled=true;otaAuth=auth;}        // enables Over-the-Air updates, with (auth=true) or without (auth=false) authorization password
   void setSketchVersion(const char *sVer){sketchVersion=sVer;}            // set optional sketch version number
@@ -186,6 +468,9 @@ struct Span{
   
   void enableAutoStartAP(){autoStartAPEnabled=true;}                      // enables auto start-up of Access Point when WiFi Credentials not found
   void setWifiCredentials(const char *ssid, const char *pwd);             // sets WiFi Credentials
+
+  boolean deleteAccessory(uint32_t aid);        // deletes Accessory with matching aid, along with its Services, Characteristics, and PushButtons; returns true if found and deleted
+  boolean updateDatabase();                     // validates and indexes any Accessories added after start-up, and updates configuration number (and MDNS "c#") if database has changed; returns true if changed
 };
 
 ///////////////////////////////
@@ -196,10 +481,16 @@ struct SpanAccessory{
   int iidCount=0;                           // running count of iid to use for Services and Characteristics associated with this Accessory                                 
   vector<SpanService *> Services;           // vector of pointers to all Services in this Accessory  
 
+  boolean validated=false;                  // set once Accessory has been error-checked
+
   SpanAccessory(uint32_t aid=0);
+  ~SpanAccessory();                         // deletes all Services in this Accessory
 
   int sprintfAttributes(char *cBuf);        // prints Accessory JSON database into buf, unless buf=NULL; return number of characters printed, excluding null terminator, even if buf=NULL  
-  void validate();                          // error-checks Accessory
+  void validate();                          // error-checks Accessory, including its last Service (does nothing if already validated)
+
+  void *operator new(size_t size){return(HeapTag::newObject(HeapTag::DATABASE,size));}      // track allocations as part of the Database
+  void operator delete(void *p){HeapTag::free(HeapTag::DATABASE,p);}
 };
 
 ///////////////////////////////
@@ -208,15 +499,22 @@ struct SpanService{
 
   int iid=0;                                              // Instance ID (HAP Table 6-2)
   const char *type;                                       // Service Type
+  uint32_t typeNum;                                       // Service Type as short-form number (0 if custom 128-bit UUID)
   const char *hapName;                                    // HAP Name
   boolean hidden=false;                                   // optional property indicating service is hidden
   boolean primary=false;                                  // optional property indicating service is primary
   vector<SpanCharacteristic *> Characteristics;           // vector of pointers to all Characteristics in this Service  
-  vector<HapChar *> req;                                  // vector of pointers to all required HAP Characteristic Types for this Service
-  vector<HapChar *> opt;                                  // vector of pointers to all optional HAP Characteristic Types for this Service
+  HapSchema schema;                                       // sets of required and optional HAP Characteristic Types for this Service
+  HapMask present={};                                     // set of HAP Characteristic Types already added to this Service
   vector<SpanService *> linkedServices;                   // vector of pointers to any optional linked Services
+  uint32_t aid=0;                                         // Accessory Instance ID of Accessory containing this Service
+  uint64_t cpuTime=0;                                     // cumulative time (in microseconds) spent in this Service's loop(), button(), and update() methods
+  uint32_t maxTime=0;                                     // longest time (in microseconds) spent in any single call to these methods
+  uint32_t nStalls=0;                                     // number of calls to these methods that exceeded homeSpan.callbackBudget
   
-  SpanService(const char *type, const char *hapName);
+  SpanService(const char *type, const char *hapName);                       // creates Service of type specified as either a short-form string or a full 128-bit UUID
+  SpanService(const char *type, uint32_t typeNum, const char *hapName, HapSchema schema=HapSchema());     // creates Service of type specified in both string and numeric forms (use HAPTYPE() macro) with optional schema of supported Characteristics
+  virtual ~SpanService();                                 // deletes all Characteristics in this Service (virtual so that user-defined Services derived from SpanService are fully destroyed)
 
   SpanService *setPrimary();                              // sets the Service Type to be primary and returns pointer to self
   SpanService *setHidden();                               // sets the Service Type to be hidden and returns pointer to self
@@ -224,6 +522,9 @@ struct SpanService{
 
   int sprintfAttributes(char *cBuf);                      // prints Service JSON records into buf; return number of characters printed, excluding null terminator
   void validate();                                        // error-checks Service
+
+  void *operator new(size_t size){return(HeapTag::newObject(HeapTag::DATABASE,size));}      // track allocations as part of the Database (also applies to user-defined Services derived from SpanService)
+  void operator delete(void *p){HeapTag::free(HeapTag::DATABASE,p);}
   
   virtual boolean update() {return(true);}                // placeholder for code that is called when a Service is updated via a Controller.  Must return true/false depending on success of update
   virtual void loop(){}                                   // loops for each Service - called every cycle and can be over-ridden with user-defined code
@@ -234,50 +535,44 @@ struct SpanService{
 
 struct SpanCharacteristic{
 
-
-  union UVal {                                  
-    boolean BOOL;
-    uint8_t UINT8;
-    uint16_t UINT16;
-    uint32_t UINT32;
-    uint64_t UINT64;
-    int32_t INT;
-    double FLOAT;
-    char *STRING = NULL;
-  };
-
-  int iid=0;                               // Instance ID (HAP Table 6-3)
-  const char *type;                        // Characteristic Type
-  const char *hapName;                     // HAP Name
-  UVal value;                              // Characteristic Value
-  uint8_t perms;                           // Characteristic Permissions
-  FORMAT format;                           // Characteristic Format        
+  int slot;                                // slot in homeSpan.charStore holding the Instance ID (HAP Table 6-3), Accessory ID, format, permissions, Event Notify Enable, and Value of this Characteristic
+  const HapChar *hapChar;                  // HAP Characteristic Type, Name, Permissions, Format, and default Range (shared entry in flash-resident hapChars table)
+  uint8_t index;                           // index of hapChar in hapChars table, or HapChar::CUSTOM
   char *desc=NULL;                         // Characteristic Description (optional)
-  UVal minValue;                           // Characteristic minimum (not applicable for STRING)
-  UVal maxValue;                           // Characteristic maximum (not applicable for STRING)
-  UVal stepValue;                          // Characteristic step size (not applicable for STRING)
-  boolean staticRange;                     // Flag that indiates whether Range is static and cannot be changed with setRange()
-  boolean customRange=false;               // Flag for custom ranges
-  boolean *ev;                             // Characteristic Event Notify Enable (per-connection)
-  char *nvsKey=NULL;                       // key for NVS storage of Characteristic value
-  
-  uint32_t aid=0;                          // Accessory ID - passed through from Service containing this Characteristic
+  UVal *customRange=NULL;                  // Characteristic custom [min,max,step], allocated only if set with setRange() or init(val,nvsStore,min,max) (not applicable for STRING)
+  boolean initRange=false;                 // Flag indicating customRange holds the default [min,max] passed to init(), rather than a range set with setRange()
+  boolean nvsStore=false;                  // Flag indicating whether Characteristic value is stored in NVS (key is generated on demand with getNvsKey())
   boolean isUpdated=false;                 // set to true when new value has been requested by PUT /characteristic
   unsigned long updateTime=0;              // last time value was updated (in millis) either by PUT /characteristic OR by setVal()
   UVal newValue;                           // the updated value requested by PUT /characteristic
   SpanService *service=NULL;               // pointer to Service containing this Characteristic
       
-  SpanCharacteristic(HapChar *hapChar);           // contructor
+  SpanCharacteristic(const HapChar *hapChar);     // contructor
+  virtual ~SpanCharacteristic();                  // frees any STRING values and custom range (virtual since Services delete their Characteristics through SpanCharacteristic pointers)
+
+  void *operator new(size_t size){return(HeapTag::newObject(HeapTag::DATABASE,size));}      // track allocations as part of the Database
+  void operator delete(void *p){HeapTag::free(HeapTag::DATABASE,p);}
   
   int sprintfAttributes(char *cBuf, int flags);   // prints Characteristic JSON records into buf, according to flags mask; return number of characters printed, excluding null terminator  
   StatusCode loadUpdate(char *val, char *ev);     // load updated val/ev from PUT /characteristic JSON request.  Return intiial HAP status code (checks to see if characteristic is found, is writable, etc.)
   
+  int &iid(){return(homeSpan.charStore.iid[slot]);}                 // Instance ID
+  uint32_t &aid(){return(homeSpan.charStore.aid[slot]);}            // Accessory ID - passed through from Service containing this Characteristic
+  FORMAT format(){return((FORMAT)homeSpan.charStore.format[slot]);} // format (same as hapChar->format, without reading HapChar)
+  PERMS perms(){return((PERMS)homeSpan.charStore.perms[slot]);}     // permissions (same as hapChar->perms, without reading HapChar)
+  uint32_t &ev(){return(homeSpan.charStore.ev[slot]);}              // Event Notify Enable (one bit per connection slot)
+  UVal &value(){return(homeSpan.charStore.value[slot]);}            // Characteristic Value (reference is only valid until the next Characteristic is created)
+
   boolean updated(){return(isUpdated);}           // returns isUpdated
+  double minRange(){return(customRange?uvGet<double>(customRange[0]):hapChar->minValue);}     // returns minimum of custom range, if set, otherwise default minimum
+  double maxRange(){return(customRange?uvGet<double>(customRange[1]):hapChar->maxValue);}     // returns maximum of custom range, if set, otherwise default maximum
+  boolean hasRange(){return(customRange || hapChar->hasRange());}                             // returns true if either a custom or default range applies
+  void getNvsKey(char *key);                      // writes 16-byte NVS storage key for this Characteristic (derived from type, aid, and iid) into key
   unsigned long timeVal();                        // returns time elapsed (in millis) since value was last updated
     
   String uvPrint(UVal &u){
     char c[64];
-    switch(format){
+    switch(format()){
       case FORMAT::BOOL:
         return(String(u.BOOL));      
       case FORMAT::INT:
@@ -301,27 +596,27 @@ struct SpanCharacteristic{
   } // str()
 
   void uvSet(UVal &u, const char *val){
-    u.STRING = (char *)realloc(u.STRING, strlen(val) + 1);
+    u.STRING = (char *)HeapTag::realloc(HeapTag::DATABASE, u.STRING, strlen(val) + 1);
     strncpy(u.STRING, val, strlen(val));
     u.STRING[strlen(val)] = '\0';
   }
 
   char *getString(){
-    if(format == FORMAT::STRING)
-        return value.STRING;
+    if(hapChar->format == FORMAT::STRING)
+        return value().STRING;
 
     return NULL;
   }
 
   char *getNewString(){
-    if(format == FORMAT::STRING)
+    if(hapChar->format == FORMAT::STRING)
         return newValue.STRING;
 
     return NULL;
   }
 
   template <typename T> void uvSet(UVal &u, T val){  
-    switch(format){
+    switch(format()){
       case FORMAT::BOOL:
         u.BOOL=(boolean)val;
       break;
@@ -348,7 +643,7 @@ struct SpanCharacteristic{
  
   template <class T> T uvGet(UVal &u){
   
-    switch(format){   
+    switch(format()){   
       case FORMAT::BOOL:
         return((T) u.BOOL);        
       case FORMAT::INT:
@@ -371,106 +666,97 @@ struct SpanCharacteristic{
     
   template <typename A, typename B, typename S=int> SpanCharacteristic *setRange(A min, B max, S step=0){
 
-    char c[256];
-    homeSpan.configLog+=String("         \u2b0c Set Range for ") + String(hapName) + " with IID=" + String(iid);
-
-    if(customRange){
-      sprintf(c,"  *** ERROR!  Range already set for this Characteristic! ***\n");
+    if(customRange && !initRange){
+      homeSpan.addConfig(SpanConfigRecord::RANGE,this,SpanConfigRecord::FAILED);
+      homeSpan.addConfigNote("  *** ERROR!  Range already set for this Characteristic! ***");
       homeSpan.nFatalErrors++;
     } else 
         
-    if(staticRange){     
-      sprintf(c,"  *** ERROR!  Can't change range for this Characteristic! ***\n");
+    if(hapChar->staticRange){     
+      homeSpan.addConfig(SpanConfigRecord::RANGE,this,SpanConfigRecord::FAILED);
+      homeSpan.addConfigNote("  *** ERROR!  Can't change range for this Characteristic! ***");
       homeSpan.nFatalErrors++;
     } else {
       
-      uvSet(minValue,min);
-      uvSet(maxValue,max);
-      uvSet(stepValue,step);  
-      customRange=true; 
-      
-      if(uvGet<double>(stepValue)>0)
-        sprintf(c,": Min=%s, Max=%s, Step=%s\n",uvPrint(minValue),uvPrint(maxValue),uvPrint(stepValue));
-      else
-        sprintf(c,": Min=%s, Max=%s\n",uvPrint(minValue),uvPrint(maxValue));        
+      if(!customRange)
+        customRange=(UVal *)HeapTag::calloc(HeapTag::DATABASE,3,sizeof(UVal));      // allocate [min,max,step] only for Characteristics with a custom range
+      uvSet(customRange[0],min);
+      uvSet(customRange[1],max);
+      uvSet(customRange[2],step);  
+      initRange=false;
+      homeSpan.addConfig(SpanConfigRecord::RANGE,this);
     }
-    homeSpan.configLog+=c;         
+
     return(this);
     
   } // setRange()
+
+  template <typename T, typename A, typename B> void init(T val, boolean nvsStore, A min, B max){     // form used by custom Characteristics that specify their own default range
+
+    if(hapChar->format!=FORMAT::STRING && ((double)min!=hapChar->minValue || (double)max!=hapChar->maxValue)){
+      customRange=(UVal *)HeapTag::calloc(HeapTag::DATABASE,3,sizeof(UVal));
+      uvSet(customRange[0],min);
+      uvSet(customRange[1],max);
+      initRange=true;
+    }
+
+    init(val,nvsStore);
+  }
     
-  template <typename T, typename A=boolean, typename B=boolean> void init(T val, boolean nvsStore, A min=0, B max=1){
+  template <typename T> void init(T val, boolean nvsStore){
 
-    int nvsFlag=0;
+    uint8_t nvsFlag=0;
 
-    uvSet(value,val);
+    uvSet(value(),val);
     uvSet(newValue,val);
 
-    if(format != FORMAT::STRING) {
-        uvSet(minValue,min);
-        uvSet(maxValue,max);
-        uvSet(stepValue,0);
-    }
+    this->nvsStore=nvsStore;
 
     if(nvsStore){
-      nvsKey=(char *)malloc(16);
-      uint16_t t;
-      sscanf(type,"%x",&t);
-      sprintf(nvsKey,"%04X%08X%03X",t,aid,iid&0xFFF);
+      char nvsKey[16];
+      getNvsKey(nvsKey);
       size_t len;
     
       if(!nvs_get_blob(homeSpan.charNVS,nvsKey,NULL,&len)){
-        nvs_get_blob(homeSpan.charNVS,nvsKey,&value,&len);
-        newValue=value;
-        nvsFlag=2;
+        nvs_get_blob(homeSpan.charNVS,nvsKey,&value(),&len);
+        newValue=value();
+        nvsFlag=SpanConfigRecord::RESTORED;
       }
       else {
-        nvs_set_blob(homeSpan.charNVS,nvsKey,&value,sizeof(UVal));       // store data
+        nvs_set_blob(homeSpan.charNVS,nvsKey,&value(),sizeof(UVal));       // store data
         nvs_commit(homeSpan.charNVS);                                    // commit to NVS  
-        nvsFlag=1;
+        nvsFlag=SpanConfigRecord::STORING;
       }
     }
   
-    homeSpan.configLog+="(" + uvPrint(value) + ")" + ":  IID=" + String(iid) + ", UUID=0x" + String(type);
-    if(format!=FORMAT::STRING && format!=FORMAT::BOOL)
-      homeSpan.configLog+= "  Range=[" + String(uvPrint(minValue)) + "," + String(uvPrint(maxValue)) + "]";
-
-    if(nvsFlag==2)
-      homeSpan.configLog+=" (restored)";
-    else if(nvsFlag==1)
-      homeSpan.configLog+=" (storing)";
-  
-    boolean valid=false;
-  
-    for(int i=0; !valid && i<homeSpan.Accessories.back()->Services.back()->req.size(); i++)
-      valid=!strcmp(type,homeSpan.Accessories.back()->Services.back()->req[i]->type);
+    homeSpan.addConfig(SpanConfigRecord::CHARACTERISTIC,this,nvsFlag);
   
-    for(int i=0; !valid && i<homeSpan.Accessories.back()->Services.back()->opt.size(); i++)
-      valid=!strcmp(type,homeSpan.Accessories.back()->Services.back()->opt[i]->type);
+    SpanService *svc=homeSpan.Accessories.back()->Services.back();
+    boolean valid=svc->schema.empty() || index==HapChar::CUSTOM || svc->schema.allows(index);       // custom Services (empty schema) and custom Characteristics are not checked
   
     if(!valid){
-      homeSpan.configLog+=" *** ERROR!  Service does not support this Characteristic. ***";
+      homeSpan.addConfigNote(" *** ERROR!  Service does not support this Characteristic. ***");
       homeSpan.nFatalErrors++;
     }
   
     boolean repeated=false;
     
-    for(int i=0; !repeated && i<homeSpan.Accessories.back()->Services.back()->Characteristics.size(); i++)
-      repeated=!strcmp(type,homeSpan.Accessories.back()->Services.back()->Characteristics[i]->type);
+    if(index!=HapChar::CUSTOM){
+      repeated=svc->present.test(index);
+      svc->present=svc->present.set(index);
+    }
     
     if(valid && repeated){
-      homeSpan.configLog+=" *** ERROR!  Characteristic already defined for this Service. ***";
+      homeSpan.addConfigNote(" *** ERROR!  Characteristic already defined for this Service. ***");
       homeSpan.nFatalErrors++;
     }
   
-    homeSpan.Accessories.back()->Services.back()->Characteristics.push_back(this);  
-  
-    homeSpan.configLog+="\n"; 
+    svc->Characteristics.push_back(this);  
    
   } // init()
 
   template <class T=int> T getVal(){
-    return(uvGet<T>(value));
+    return(uvGet<T>(value()));
   }
 
   template <class T=int> T getNewVal(){
@@ -479,17 +765,17 @@ struct SpanCharacteristic{
     
   template <typename T> void setVal(T val){
 
-    if(format==FORMAT::STRING && perms & PW == 0){
-      Serial.printf("\n*** WARNING:  Attempt to update Characteristic::%s(\"%s\") with setVal() ignored.  No WRITE permission on this characteristic\n\n",hapName,value.STRING);
+    if(hapChar->format==FORMAT::STRING && hapChar->perms & PW == 0){
+      Serial.printf("\n*** WARNING:  Attempt to update Characteristic::%s(\"%s\") with setVal() ignored.  No WRITE permission on this characteristic\n\n",hapChar->hapName,value().STRING);
       return;
     }
 
-    if(format!=FORMAT::STRING && ( val < uvGet<T>(minValue) || val > uvGet<T>(maxValue))){
+    if(hapChar->format!=FORMAT::STRING && hasRange() && ( (double)val < minRange() || (double)val > maxRange())){
       Serial.printf("\n*** WARNING:  Attempt to update Characteristic::%s with setVal(%llg) is out of range [%llg,%llg].  This may cause device to become non-reponsive!\n\n",
-      hapName,(double)val,uvGet<double>(minValue),uvGet<double>(maxValue));
+      hapChar->hapName,(double)val,minRange(),maxRange());
     }
    
-    uvSet(value,val);
+    uvSet(value(),val);
     uvSet(newValue,val);
       
     updateTime=homeSpan.snapTime;
@@ -501,8 +787,10 @@ struct SpanCharacteristic{
     sb.val=dummy;                           // set dummy "val" so that sprintfNotify knows to consider this "update"
     homeSpan.Notifications.push_back(sb);   // store SpanBuf in Notifications vector  
 
-    if(nvsKey){
-      nvs_set_blob(homeSpan.charNVS,nvsKey,&value,sizeof(UVal));    // store data
+    if(nvsStore){
+      char nvsKey[16];
+      getNvsKey(nvsKey);
+      nvs_set_blob(homeSpan.charNVS,nvsKey,&value(),sizeof(UVal));    // store data
       nvs_commit(homeSpan.charNVS);
     }
     
@@ -532,9 +820,10 @@ struct SpanButton{
   uint16_t doubleTime;           // maximum time (in millis) between single presses to register a double press instead
   SpanService *service;          // Service to which this PushButton is attached
 
-  PushButton *pushButton;        // PushButton associated with this SpanButton
+  PushButton *pushButton=NULL;   // PushButton associated with this SpanButton
 
   SpanButton(int pin, uint16_t longTime=2000, uint16_t singleTime=5, uint16_t doubleTime=200);
+  ~SpanButton();                 // detaches interrupt from pin and deletes PushButton
 };
 
 ///////////////////////////////
@@ -39,8 +39,10 @@ void Network::scan(){
 
   int n=WiFi.scanNetworks();
 
-  free(ssidList);
-  ssidList=(char **)calloc(n,sizeof(char *));
+  for(int i=0;ssidList && i<numSSID;i++)           // free strings from any prior scan
+    HeapTag::free(HeapTag::NETWORK,ssidList[i]);
+  HeapTag::free(HeapTag::NETWORK,ssidList);
+  ssidList=(char **)HeapTag::calloc(HeapTag::NETWORK,n,sizeof(char *));
   numSSID=0;
 
   for(int i=0;i<n;i++){
@@ -50,7 +52,7 @@ void Network::scan(){
         found=true;
     }
     if(!found){
-      ssidList[numSSID]=(char *)calloc(WiFi.SSID(i).length()+1,sizeof(char));
+      ssidList[numSSID]=(char *)HeapTag::calloc(HeapTag::NETWORK,WiFi.SSID(i).length()+1,sizeof(char));
       sprintf(ssidList[numSSID],"%s",WiFi.SSID(i).c_str());
       numSSID++;
     }
@@ -133,7 +135,7 @@ void Network::apConfigure(){
   WiFiServer apServer(80);
   client=0;
   
-  TempBuffer <uint8_t> tempBuffer(MAX_HTTP+1);
+  TempBuffer <uint8_t> tempBuffer(MAX_HTTP+1,HeapTag::NETWORK);
   uint8_t *httpBuf=tempBuffer.buf;
   
   const byte DNS_PORT = 53;
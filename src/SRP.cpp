@@ -278,3 +278,24 @@ void SRP6A::print(mbedtls_mpi *mpi){
 }
 
 //////////////////////////////////////
+
+size_t SRP6A::mpiBytes(int *nAllocs){
+
+  mbedtls_mpi *mpis[]={&N,&g,&k,&s,&x,&v,&b,&B,&A,&u,&S,&K,&M1,&M1V,&M2,&t1,&t2,&t3,&_rr};
+  size_t nBytes=0;
+  int n=0;
+
+  for(int i=0;i<sizeof(mpis)/sizeof(mbedtls_mpi *);i++){
+    if(mpis[i]->n){
+      nBytes+=mpis[i]->n*sizeof(mbedtls_mpi_uint);
+      n++;
+    }
+  }
+
+  if(nAllocs)
+    *nAllocs=n;
+
+  return(nBytes);
+}
+
+//////////////////////////////////////
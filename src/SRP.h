@@ -88,5 +88,6 @@ struct SRP6A {
   void createProof();                              // create M2 server-side SRP6A Proof based on M1 as received from HAP Client
 
   void print(mbedtls_mpi *mpi);                    // prints size of mpi (in bytes), followed by the mpi itself (as a hex charcter string) - for diagnostic purposes only
+  size_t mpiBytes(int *nAllocs=NULL);              // returns number of bytes allocated by all mpi structures, and sets nAllocs (if not NULL) to the number of mpis holding an allocation - for diagnostic purposes only
   
 };
@@ -74,10 +74,16 @@
 #define     DEFAULT_COMMAND_TIMEOUT   120                 // change with homeSpan.setCommandTimeout(nSeconds)
 
 #define     DEFAULT_LOG_LEVEL         0                   // change with homeSpan.setLogLevel(level)
+#define     DEFAULT_LOG_BUFFER        0                   // change with homeSpan.setLogBuffer(nBytes)
 
 #define     DEFAULT_MAX_CONNECTIONS   8                   // change with homeSpan.setMaxConnections(num);
 #define     DEFAULT_TCP_PORT          80                  // change with homeSpan.setPort(port);
 
+#define     DEFAULT_POLL_TIMEOUT      0                   // change with homeSpan.setPollTimeout(ms);
+#define     DEFAULT_TCP_KEEPALIVE     0                   // change with homeSpan.setTcpKeepAlive(nSec);
+#define     DEFAULT_IDLE_TIMEOUT      0                   // change with homeSpan.setConnectionTimeout(nSec);
+#define     DEFAULT_CALLBACK_BUDGET   50                  // change with homeSpan.setCallbackBudget(ms);
+
 
 /////////////////////////////////////////////////////
 //              STATUS LED SETTINGS                //
@@ -94,8 +100,26 @@
 //      Message Log Level Control Macros           //
 //       0=Minimal, 1=Informative, 2=All           //
 
-#define LOG1(x) if(homeSpan.logLevel>0)Serial.print(x)
-#define LOG2(x) if(homeSpan.logLevel>1)Serial.print(x)
+#ifndef HOMESPAN_MAX_LOG_LEVEL
+#define HOMESPAN_MAX_LOG_LEVEL    2             // highest Log Level compiled into HomeSpan - messages above this level are removed entirely (override with -D build flag)
+#endif
+
+#define LOG_ON(n) (HOMESPAN_MAX_LOG_LEVEL>=(n) && homeSpan.logLevel>=(n))
+#define LOG1(x) if(LOG_ON(1))homeSpan.logOut->print(x)
+#define LOG2(x) if(LOG_ON(2))homeSpan.logOut->print(x)
+
+/////////////////////////////////////////////////////
+//      Binary Event Log Ring                      //
+
+#ifndef HOMESPAN_LOG_RING
+#define HOMESPAN_LOG_RING         0             // number of entries in binary event log ring (0=disabled; override with -D build flag)
+#endif
+
+#if HOMESPAN_LOG_RING>0
+#define LOG_EVENT(type,slot,code,a,b) homeSpan.logRing.add(SpanLogRing::type,slot,code,a,b)
+#else
+#define LOG_EVENT(type,slot,code,a,b)
+#endif
    
 
 //////////////////////////////////////////////////////
@@ -29,389 +29,394 @@
 // SPAN SERVICES (HAP Chapter 8) //
 ///////////////////////////////////
 
-// Macros to define vectors of required and optional characteristics for each Span Service structure
+// Macros to define the (compile-time) sets of required and optional characteristics for each Span Service structure
 
-#define REQ(HAPCHAR) req.push_back(&hapChars.HAPCHAR)
-#define OPT(HAPCHAR) opt.push_back(&hapChars.HAPCHAR)
+#define HAPREQ(HAPCHAR) .addReq(HapCharacteristics::HAPCHAR##_index)
+#define HAPOPT(HAPCHAR) .addOpt(HapCharacteristics::HAPCHAR##_index)
+
+// Statement forms for use in the constructor of a custom Service defined in a sketch (a custom Service that uses neither accepts any Characteristic)
+
+#define REQ(HAPCHAR) schema=schema.addReq(HapCharacteristics::HAPCHAR##_index)
+#define OPT(HAPCHAR) schema=schema.addOpt(HapCharacteristics::HAPCHAR##_index)
 
 namespace Service {
 
-  struct AccessoryInformation : SpanService { AccessoryInformation() : SpanService{"3E","AccessoryInformation"}{
-    REQ(FirmwareRevision);
-    REQ(Identify);
-    REQ(Manufacturer);
-    REQ(Model);
-    REQ(Name);
-    REQ(SerialNumber);
-    OPT(HardwareRevision);      
-  }};
-
-  struct AirPurifier : SpanService { AirPurifier() : SpanService{"BB","AirPurifier"}{
-    REQ(Active);
-    REQ(CurrentAirPurifierState);
-    REQ(TargetAirPurifierState);
-    OPT(Name);
-    OPT(RotationSpeed);
-    OPT(SwingMode);
-    OPT(LockPhysicalControls);
-  }};
-
-  struct AirQualitySensor : SpanService { AirQualitySensor() : SpanService{"8D","AirQualitySensor"}{
-    REQ(AirQuality);
-    OPT(Name);
-    OPT(OzoneDensity);
-    OPT(NitrogenDioxideDensity);
-    OPT(SulphurDioxideDensity);
-    OPT(PM25Density);
-    OPT(PM10Density);
-    OPT(VOCDensity);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);
-  }};
-
-  struct BatteryService : SpanService { BatteryService() : SpanService{"96","BatteryService"}{
-    REQ(BatteryLevel);
-    REQ(ChargingState);
-    REQ(StatusLowBattery);
-    OPT(Name);
-  }};
-
-  struct CarbonDioxideSensor : SpanService { CarbonDioxideSensor() : SpanService{"97","CarbonDioxideSensor"}{
-    REQ(CarbonDioxideDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);
-    OPT(CarbonDioxideLevel);
-    OPT(CarbonDioxidePeakLevel);
-  }};
-
-  struct CarbonMonoxideSensor : SpanService { CarbonMonoxideSensor() : SpanService{"7F","CarbonMonoxideSensor"}{
-    REQ(CarbonMonoxideDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);
-    OPT(CarbonMonoxideLevel);
-    OPT(CarbonMonoxidePeakLevel);
-    }};
-
-  struct ContactSensor : SpanService { ContactSensor() : SpanService{"80","ContactSensor"}{
-    REQ(ContactSensorState);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);
-  }};
-
-  struct Door : SpanService { Door() : SpanService{"81","Door"}{
-    REQ(CurrentPosition);
-    REQ(TargetPosition);
-    REQ(PositionState);
-    OPT(Name);
-    OPT(HoldPosition);
-    OPT(ObstructionDetected);
-  }};
-
-  struct Doorbell : SpanService { Doorbell() : SpanService{"121","Doorbell"}{
-    REQ(ProgrammableSwitchEvent);
-    OPT(Name);
-    OPT(Volume);
-    OPT(Brightness);
-  }};
-
-  struct Fan : SpanService { Fan() : SpanService{"B7","Fan"}{
-    REQ(Active);
-    OPT(Name);
-    OPT(CurrentFanState);
-    OPT(TargetFanState);
-    OPT(RotationDirection);
-    OPT(RotationSpeed);
-    OPT(SwingMode);
-    OPT(LockPhysicalControls);
-  }};
-
-  struct Faucet : SpanService { Faucet() : SpanService{"D7","Faucet"}{
-    REQ(Active);
-    OPT(StatusFault);
-    OPT(Name);
-  }};
-
-  struct FilterMaintenance : SpanService { FilterMaintenance() : SpanService{"BA","FilterMaintenance"}{
-    REQ(FilterChangeIndication);
-    OPT(Name);
-    OPT(FilterLifeLevel);
-    OPT(ResetFilterIndication);
-  }};
-
-  struct GarageDoorOpener : SpanService { GarageDoorOpener() : SpanService{"41","GarageDoorOpener"}{
-    REQ(CurrentDoorState);
-    REQ(TargetDoorState);
-    REQ(ObstructionDetected);
-    OPT(LockCurrentState);
-    OPT(LockTargetState);
-    OPT(Name);
-  }};
-
-  struct HAPProtocolInformation : SpanService { HAPProtocolInformation() : SpanService{"A2","HAPProtocolInformation"}{
-    REQ(Version);
-  }};
-
-  struct HeaterCooler : SpanService { HeaterCooler() : SpanService{"BC","HeaterCooler"}{
-    REQ(Active);
-    REQ(CurrentTemperature);
-    REQ(CurrentHeaterCoolerState);
-    REQ(TargetHeaterCoolerState);
-    OPT(Name);
-    OPT(RotationSpeed);
-    OPT(TemperatureDisplayUnits);
-    OPT(SwingMode);
-    OPT(CoolingThresholdTemperature);
-    OPT(HeatingThresholdTemperature);
-    OPT(LockPhysicalControls);
-  }};
-
-  struct HumidifierDehumidifier : SpanService { HumidifierDehumidifier() : SpanService{"BD","HumidifierDehumidifier"}{
-    REQ(Active);
-    REQ(CurrentRelativeHumidity);
-    REQ(CurrentHumidifierDehumidifierState);
-    REQ(TargetHumidifierDehumidifierState);
-    OPT(Name);
-    OPT(RelativeHumidityDehumidifierThreshold);
-    OPT(RelativeHumidityHumidifierThreshold);
-    OPT(RotationSpeed);
-    OPT(SwingMode);
-    OPT(WaterLevel);
-    OPT(LockPhysicalControls);
-  }};
-
-  struct HumiditySensor : SpanService { HumiditySensor() : SpanService{"82","HumiditySensor"}{
-    REQ(CurrentRelativeHumidity);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);   
-  }};
-
-  struct InputSource : SpanService { InputSource() : SpanService{"D9","InputSource"}{
-      REQ(ConfiguredName);
-      REQ(InputSourceType);
-      REQ(IsConfigured);
-      REQ(Name);
-      REQ(CurrentVisibilityState);
-
-      OPT(Identifier);
-      OPT(InputDeviceType);
-      OPT(TargetVisibilityState);
-  }};
-
-  struct IrrigationSystem : SpanService { IrrigationSystem() : SpanService{"CF","IrrigationSystem"}{
-    REQ(Active);
-    REQ(ProgramMode);
-    REQ(InUse);
-    OPT(RemainingDuration);
-    OPT(Name);
-    OPT(StatusFault);
-  }};
-
-  struct LeakSensor : SpanService { LeakSensor() : SpanService{"83","LeakSensor"}{
-    REQ(LeakDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);       
-  }};
-
-  struct LightBulb : SpanService { LightBulb() : SpanService{"43","LightBulb"}{
-    REQ(On);
-    OPT(Brightness);
-    OPT(Hue);
-    OPT(Name);
-    OPT(Saturation);
-    OPT(ColorTemperature);
-  }};
-
-  struct LightSensor : SpanService { LightSensor() : SpanService{"84","LightSensor"}{
-    REQ(CurrentAmbientLightLevel);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);          
-  }};
-
-  struct LockMechanism : SpanService { LockMechanism() : SpanService{"45","LockMechanism"}{
-    REQ(LockCurrentState);
-    REQ(LockTargetState);
-    OPT(Name);
-  }};
-
-  struct Microphone : SpanService { Microphone() : SpanService{"112","Microphone"}{
-    REQ(Mute);
-    OPT(Name);
-    OPT(Volume);
-  }};
-
-  struct MotionSensor : SpanService { MotionSensor() : SpanService{"85","MotionSensor"}{
-    REQ(MotionDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);       
-  }};
-
-  struct OccupancySensor : SpanService { OccupancySensor() : SpanService{"86","OccupancySensor"}{
-    REQ(OccupancyDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);         
-  }};
-
-  struct Outlet : SpanService { Outlet() : SpanService{"47","Outlet"}{
-    REQ(On);
-    REQ(OutletInUse);
-    OPT(Name);
-  }};
-
-  struct SecuritySystem : SpanService { SecuritySystem() : SpanService{"7E","SecuritySystem"}{
-    REQ(SecuritySystemCurrentState);
-    REQ(SecuritySystemTargetState);
-    OPT(Name);
-    OPT(SecuritySystemAlarmType);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-  }};  
-
-  struct ServiceLabel : SpanService { ServiceLabel() : SpanService{"CC","ServiceLabel"}{
-    REQ(ServiceLabelNamespace);
-  }};  
-
-  struct Slat : SpanService { Slat() : SpanService{"B9","Slat"}{
-    REQ(CurrentSlatState);
-    REQ(SlatType);
-    OPT(Name);
-    OPT(SwingMode);
-    OPT(CurrentTiltAngle);
-    OPT(TargetTiltAngle);
-  }};
-
-  struct SmokeSensor : SpanService { SmokeSensor() : SpanService{"87","SmokeSensor"}{
-    REQ(SmokeDetected);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);             
-  }};
-
-  struct Speaker : SpanService { Speaker() : SpanService{"113","Speaker"}{
-    REQ(Mute);
-    OPT(Name);
-    OPT(Volume);
-  }};
-
-  struct StatelessProgrammableSwitch : SpanService { StatelessProgrammableSwitch() : SpanService{"89","StatelessProgrammableSwitch"}{
-    REQ(ProgrammableSwitchEvent);
-    OPT(Name);
-    OPT(ServiceLabelIndex);
-  }};
-
-  struct Switch : SpanService { Switch() : SpanService{"49","Switch"}{
-    REQ(On);
-    OPT(Name);
-  }};
-
-  struct Television : SpanService { Television() : SpanService{"D8","Television"}{
-      REQ(Active);
-      REQ(ActiveIdentifier);
-      REQ(ConfiguredName);
-      REQ(RemoteKey);
-      REQ(SleepDiscoveryMode);
-
-      OPT(Brightness);
-      OPT(ClosedCaptions);
-      //OPT(DisplayOrder);
-      OPT(CurrentMediaState);
-      OPT(TargetMediaState);
-      OPT(Name);
-      OPT(PictureMode);
-      OPT(PowerModeSelection);
-  }};
-
-  struct TelevisionSpeaker : SpanService { TelevisionSpeaker() : SpanService{"113","TelevisionSpeaker"}{
-      REQ(Mute);
-
-      OPT(Active);
-      OPT(Volume);
-      OPT(VolumeControlType);
-      OPT(VolumeSelector);
-  }};
-
-  struct TemperatureSensor : SpanService { TemperatureSensor() : SpanService{"8A","TemperatureSensor"}{
-    REQ(CurrentTemperature);
-    OPT(Name);
-    OPT(StatusActive);
-    OPT(StatusFault);
-    OPT(StatusTampered);
-    OPT(StatusLowBattery);
-  }};
-
-  struct Thermostat : SpanService { Thermostat() : SpanService{"4A","Thermostat"}{
-    REQ(CurrentHeatingCoolingState);
-    REQ(TargetHeatingCoolingState);
-    REQ(CurrentTemperature);
-    REQ(TargetTemperature);
-    REQ(TemperatureDisplayUnits);
-    OPT(CoolingThresholdTemperature);
-    OPT(CurrentRelativeHumidity);
-    OPT(HeatingThresholdTemperature);
-    OPT(Name);
-    OPT(TargetRelativeHumidity);
-  }};
-
-  struct Valve : SpanService { Valve() : SpanService{"D0","Valve"}{
-    REQ(Active);
-    REQ(InUse);
-    REQ(ValveType);
-    OPT(SetDuration);
-    OPT(RemainingDuration);
-    OPT(IsConfigured);
-    OPT(ServiceLabelIndex);
-    OPT(StatusFault);
-    OPT(Name);
-  }};
-
-  struct Window : SpanService { Window() : SpanService{"8B","Window"}{
-    REQ(CurrentPosition);
-    REQ(TargetPosition);
-    REQ(PositionState);
-    OPT(Name);
-    OPT(HoldPosition);
-    OPT(ObstructionDetected);
-  }};
-
-  struct WindowCovering : SpanService { WindowCovering() : SpanService{"8C","WindowCovering"}{
-    REQ(TargetPosition);
-    REQ(CurrentPosition);
-    REQ(PositionState);   
-    OPT(Name);
-    OPT(HoldPosition);
-    OPT(CurrentHorizontalTiltAngle);
-    OPT(TargetHorizontalTiltAngle);
-    OPT(CurrentVerticalTiltAngle);
-    OPT(TargetVerticalTiltAngle);
-    OPT(ObstructionDetected);
-  }};
+  struct AccessoryInformation : SpanService { AccessoryInformation() : SpanService{HAPTYPE(3E),"AccessoryInformation",HapSchema()
+    HAPREQ(FirmwareRevision)
+    HAPREQ(Identify)
+    HAPREQ(Manufacturer)
+    HAPREQ(Model)
+    HAPREQ(Name)
+    HAPREQ(SerialNumber)
+    HAPOPT(HardwareRevision)
+  }{}};
+
+  struct AirPurifier : SpanService { AirPurifier() : SpanService{HAPTYPE(BB),"AirPurifier",HapSchema()
+    HAPREQ(Active)
+    HAPREQ(CurrentAirPurifierState)
+    HAPREQ(TargetAirPurifierState)
+    HAPOPT(Name)
+    HAPOPT(RotationSpeed)
+    HAPOPT(SwingMode)
+    HAPOPT(LockPhysicalControls)
+  }{}};
+
+  struct AirQualitySensor : SpanService { AirQualitySensor() : SpanService{HAPTYPE(8D),"AirQualitySensor",HapSchema()
+    HAPREQ(AirQuality)
+    HAPOPT(Name)
+    HAPOPT(OzoneDensity)
+    HAPOPT(NitrogenDioxideDensity)
+    HAPOPT(SulphurDioxideDensity)
+    HAPOPT(PM25Density)
+    HAPOPT(PM10Density)
+    HAPOPT(VOCDensity)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct BatteryService : SpanService { BatteryService() : SpanService{HAPTYPE(96),"BatteryService",HapSchema()
+    HAPREQ(BatteryLevel)
+    HAPREQ(ChargingState)
+    HAPREQ(StatusLowBattery)
+    HAPOPT(Name)
+  }{}};
+
+  struct CarbonDioxideSensor : SpanService { CarbonDioxideSensor() : SpanService{HAPTYPE(97),"CarbonDioxideSensor",HapSchema()
+    HAPREQ(CarbonDioxideDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+    HAPOPT(CarbonDioxideLevel)
+    HAPOPT(CarbonDioxidePeakLevel)
+  }{}};
+
+  struct CarbonMonoxideSensor : SpanService { CarbonMonoxideSensor() : SpanService{HAPTYPE(7F),"CarbonMonoxideSensor",HapSchema()
+    HAPREQ(CarbonMonoxideDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+    HAPOPT(CarbonMonoxideLevel)
+    HAPOPT(CarbonMonoxidePeakLevel)
+  }{}};
+
+  struct ContactSensor : SpanService { ContactSensor() : SpanService{HAPTYPE(80),"ContactSensor",HapSchema()
+    HAPREQ(ContactSensorState)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct Door : SpanService { Door() : SpanService{HAPTYPE(81),"Door",HapSchema()
+    HAPREQ(CurrentPosition)
+    HAPREQ(TargetPosition)
+    HAPREQ(PositionState)
+    HAPOPT(Name)
+    HAPOPT(HoldPosition)
+    HAPOPT(ObstructionDetected)
+  }{}};
+
+  struct Doorbell : SpanService { Doorbell() : SpanService{HAPTYPE(121),"Doorbell",HapSchema()
+    HAPREQ(ProgrammableSwitchEvent)
+    HAPOPT(Name)
+    HAPOPT(Volume)
+    HAPOPT(Brightness)
+  }{}};
+
+  struct Fan : SpanService { Fan() : SpanService{HAPTYPE(B7),"Fan",HapSchema()
+    HAPREQ(Active)
+    HAPOPT(Name)
+    HAPOPT(CurrentFanState)
+    HAPOPT(TargetFanState)
+    HAPOPT(RotationDirection)
+    HAPOPT(RotationSpeed)
+    HAPOPT(SwingMode)
+    HAPOPT(LockPhysicalControls)
+  }{}};
+
+  struct Faucet : SpanService { Faucet() : SpanService{HAPTYPE(D7),"Faucet",HapSchema()
+    HAPREQ(Active)
+    HAPOPT(StatusFault)
+    HAPOPT(Name)
+  }{}};
+
+  struct FilterMaintenance : SpanService { FilterMaintenance() : SpanService{HAPTYPE(BA),"FilterMaintenance",HapSchema()
+    HAPREQ(FilterChangeIndication)
+    HAPOPT(Name)
+    HAPOPT(FilterLifeLevel)
+    HAPOPT(ResetFilterIndication)
+  }{}};
+
+  struct GarageDoorOpener : SpanService { GarageDoorOpener() : SpanService{HAPTYPE(41),"GarageDoorOpener",HapSchema()
+    HAPREQ(CurrentDoorState)
+    HAPREQ(TargetDoorState)
+    HAPREQ(ObstructionDetected)
+    HAPOPT(LockCurrentState)
+    HAPOPT(LockTargetState)
+    HAPOPT(Name)
+  }{}};
+
+  struct HAPProtocolInformation : SpanService { HAPProtocolInformation() : SpanService{HAPTYPE(A2),"HAPProtocolInformation",HapSchema()
+    HAPREQ(Version)
+  }{}};
+
+  struct HeaterCooler : SpanService { HeaterCooler() : SpanService{HAPTYPE(BC),"HeaterCooler",HapSchema()
+    HAPREQ(Active)
+    HAPREQ(CurrentTemperature)
+    HAPREQ(CurrentHeaterCoolerState)
+    HAPREQ(TargetHeaterCoolerState)
+    HAPOPT(Name)
+    HAPOPT(RotationSpeed)
+    HAPOPT(TemperatureDisplayUnits)
+    HAPOPT(SwingMode)
+    HAPOPT(CoolingThresholdTemperature)
+    HAPOPT(HeatingThresholdTemperature)
+    HAPOPT(LockPhysicalControls)
+  }{}};
+
+  struct HumidifierDehumidifier : SpanService { HumidifierDehumidifier() : SpanService{HAPTYPE(BD),"HumidifierDehumidifier",HapSchema()
+    HAPREQ(Active)
+    HAPREQ(CurrentRelativeHumidity)
+    HAPREQ(CurrentHumidifierDehumidifierState)
+    HAPREQ(TargetHumidifierDehumidifierState)
+    HAPOPT(Name)
+    HAPOPT(RelativeHumidityDehumidifierThreshold)
+    HAPOPT(RelativeHumidityHumidifierThreshold)
+    HAPOPT(RotationSpeed)
+    HAPOPT(SwingMode)
+    HAPOPT(WaterLevel)
+    HAPOPT(LockPhysicalControls)
+  }{}};
+
+  struct HumiditySensor : SpanService { HumiditySensor() : SpanService{HAPTYPE(82),"HumiditySensor",HapSchema()
+    HAPREQ(CurrentRelativeHumidity)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct InputSource : SpanService { InputSource() : SpanService{HAPTYPE(D9),"InputSource",HapSchema()
+      HAPREQ(ConfiguredName)
+      HAPREQ(InputSourceType)
+      HAPREQ(IsConfigured)
+      HAPREQ(Name)
+      HAPREQ(CurrentVisibilityState)
+
+      HAPOPT(Identifier)
+      HAPOPT(InputDeviceType)
+      HAPOPT(TargetVisibilityState)
+  }{}};
+
+  struct IrrigationSystem : SpanService { IrrigationSystem() : SpanService{HAPTYPE(CF),"IrrigationSystem",HapSchema()
+    HAPREQ(Active)
+    HAPREQ(ProgramMode)
+    HAPREQ(InUse)
+    HAPOPT(RemainingDuration)
+    HAPOPT(Name)
+    HAPOPT(StatusFault)
+  }{}};
+
+  struct LeakSensor : SpanService { LeakSensor() : SpanService{HAPTYPE(83),"LeakSensor",HapSchema()
+    HAPREQ(LeakDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct LightBulb : SpanService { LightBulb() : SpanService{HAPTYPE(43),"LightBulb",HapSchema()
+    HAPREQ(On)
+    HAPOPT(Brightness)
+    HAPOPT(Hue)
+    HAPOPT(Name)
+    HAPOPT(Saturation)
+    HAPOPT(ColorTemperature)
+  }{}};
+
+  struct LightSensor : SpanService { LightSensor() : SpanService{HAPTYPE(84),"LightSensor",HapSchema()
+    HAPREQ(CurrentAmbientLightLevel)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct LockMechanism : SpanService { LockMechanism() : SpanService{HAPTYPE(45),"LockMechanism",HapSchema()
+    HAPREQ(LockCurrentState)
+    HAPREQ(LockTargetState)
+    HAPOPT(Name)
+  }{}};
+
+  struct Microphone : SpanService { Microphone() : SpanService{HAPTYPE(112),"Microphone",HapSchema()
+    HAPREQ(Mute)
+    HAPOPT(Name)
+    HAPOPT(Volume)
+  }{}};
+
+  struct MotionSensor : SpanService { MotionSensor() : SpanService{HAPTYPE(85),"MotionSensor",HapSchema()
+    HAPREQ(MotionDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct OccupancySensor : SpanService { OccupancySensor() : SpanService{HAPTYPE(86),"OccupancySensor",HapSchema()
+    HAPREQ(OccupancyDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct Outlet : SpanService { Outlet() : SpanService{HAPTYPE(47),"Outlet",HapSchema()
+    HAPREQ(On)
+    HAPREQ(OutletInUse)
+    HAPOPT(Name)
+  }{}};
+
+  struct SecuritySystem : SpanService { SecuritySystem() : SpanService{HAPTYPE(7E),"SecuritySystem",HapSchema()
+    HAPREQ(SecuritySystemCurrentState)
+    HAPREQ(SecuritySystemTargetState)
+    HAPOPT(Name)
+    HAPOPT(SecuritySystemAlarmType)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+  }{}};  
+
+  struct ServiceLabel : SpanService { ServiceLabel() : SpanService{HAPTYPE(CC),"ServiceLabel",HapSchema()
+    HAPREQ(ServiceLabelNamespace)
+  }{}};  
+
+  struct Slat : SpanService { Slat() : SpanService{HAPTYPE(B9),"Slat",HapSchema()
+    HAPREQ(CurrentSlatState)
+    HAPREQ(SlatType)
+    HAPOPT(Name)
+    HAPOPT(SwingMode)
+    HAPOPT(CurrentTiltAngle)
+    HAPOPT(TargetTiltAngle)
+  }{}};
+
+  struct SmokeSensor : SpanService { SmokeSensor() : SpanService{HAPTYPE(87),"SmokeSensor",HapSchema()
+    HAPREQ(SmokeDetected)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct Speaker : SpanService { Speaker() : SpanService{HAPTYPE(113),"Speaker",HapSchema()
+    HAPREQ(Mute)
+    HAPOPT(Name)
+    HAPOPT(Volume)
+  }{}};
+
+  struct StatelessProgrammableSwitch : SpanService { StatelessProgrammableSwitch() : SpanService{HAPTYPE(89),"StatelessProgrammableSwitch",HapSchema()
+    HAPREQ(ProgrammableSwitchEvent)
+    HAPOPT(Name)
+    HAPOPT(ServiceLabelIndex)
+  }{}};
+
+  struct Switch : SpanService { Switch() : SpanService{HAPTYPE(49),"Switch",HapSchema()
+    HAPREQ(On)
+    HAPOPT(Name)
+  }{}};
+
+  struct Television : SpanService { Television() : SpanService{HAPTYPE(D8),"Television",HapSchema()
+      HAPREQ(Active)
+      HAPREQ(ActiveIdentifier)
+      HAPREQ(ConfiguredName)
+      HAPREQ(RemoteKey)
+      HAPREQ(SleepDiscoveryMode)
+
+      HAPOPT(Brightness)
+      HAPOPT(ClosedCaptions)
+      //HAPOPT(DisplayOrder)
+      HAPOPT(CurrentMediaState)
+      HAPOPT(TargetMediaState)
+      HAPOPT(Name)
+      HAPOPT(PictureMode)
+      HAPOPT(PowerModeSelection)
+  }{}};
+
+  struct TelevisionSpeaker : SpanService { TelevisionSpeaker() : SpanService{HAPTYPE(113),"TelevisionSpeaker",HapSchema()
+      HAPREQ(Mute)
+
+      HAPOPT(Active)
+      HAPOPT(Volume)
+      HAPOPT(VolumeControlType)
+      HAPOPT(VolumeSelector)
+  }{}};
+
+  struct TemperatureSensor : SpanService { TemperatureSensor() : SpanService{HAPTYPE(8A),"TemperatureSensor",HapSchema()
+    HAPREQ(CurrentTemperature)
+    HAPOPT(Name)
+    HAPOPT(StatusActive)
+    HAPOPT(StatusFault)
+    HAPOPT(StatusTampered)
+    HAPOPT(StatusLowBattery)
+  }{}};
+
+  struct Thermostat : SpanService { Thermostat() : SpanService{HAPTYPE(4A),"Thermostat",HapSchema()
+    HAPREQ(CurrentHeatingCoolingState)
+    HAPREQ(TargetHeatingCoolingState)
+    HAPREQ(CurrentTemperature)
+    HAPREQ(TargetTemperature)
+    HAPREQ(TemperatureDisplayUnits)
+    HAPOPT(CoolingThresholdTemperature)
+    HAPOPT(CurrentRelativeHumidity)
+    HAPOPT(HeatingThresholdTemperature)
+    HAPOPT(Name)
+    HAPOPT(TargetRelativeHumidity)
+  }{}};
+
+  struct Valve : SpanService { Valve() : SpanService{HAPTYPE(D0),"Valve",HapSchema()
+    HAPREQ(Active)
+    HAPREQ(InUse)
+    HAPREQ(ValveType)
+    HAPOPT(SetDuration)
+    HAPOPT(RemainingDuration)
+    HAPOPT(IsConfigured)
+    HAPOPT(ServiceLabelIndex)
+    HAPOPT(StatusFault)
+    HAPOPT(Name)
+  }{}};
+
+  struct Window : SpanService { Window() : SpanService{HAPTYPE(8B),"Window",HapSchema()
+    HAPREQ(CurrentPosition)
+    HAPREQ(TargetPosition)
+    HAPREQ(PositionState)
+    HAPOPT(Name)
+    HAPOPT(HoldPosition)
+    HAPOPT(ObstructionDetected)
+  }{}};
+
+  struct WindowCovering : SpanService { WindowCovering() : SpanService{HAPTYPE(8C),"WindowCovering",HapSchema()
+    HAPREQ(TargetPosition)
+    HAPREQ(CurrentPosition)
+    HAPREQ(PositionState)
+    HAPOPT(Name)
+    HAPOPT(HoldPosition)
+    HAPOPT(CurrentHorizontalTiltAngle)
+    HAPOPT(TargetHorizontalTiltAngle)
+    HAPOPT(CurrentVerticalTiltAngle)
+    HAPOPT(TargetVerticalTiltAngle)
+    HAPOPT(ObstructionDetected)
+  }{}};
 
 }
 
@@ -419,128 +424,128 @@ namespace Service {
 // SPAN CHARACTERISTICS (HAP Chapter 9) //
 //////////////////////////////////////////
 
-// Macro to define Span Characteristic structures based on name of HAP Characteristic, default value, and mix/max value (not applicable for STRING or BOOL which default to min=0, max=1)
+// Macro to define Span Characteristic structures based on name of HAP Characteristic and default value (default min/max values are stored in hapChars)
 
-#define CREATE_CHAR(TYPE,HAPCHAR,DEFVAL,MINVAL,MAXVAL) \
-  struct HAPCHAR : SpanCharacteristic { HAPCHAR(TYPE val=DEFVAL, boolean nvsStore=false) : SpanCharacteristic {&hapChars.HAPCHAR} { init(val,nvsStore,(TYPE)MINVAL,(TYPE)MAXVAL); } };
+#define CREATE_CHAR(TYPE,HAPCHAR,DEFVAL) \
+  struct HAPCHAR : SpanCharacteristic { HAPCHAR(TYPE val=DEFVAL, boolean nvsStore=false) : SpanCharacteristic {&hapChars.HAPCHAR} { init(val,nvsStore); } };
 
 namespace Characteristic {
 
-  CREATE_CHAR(uint8_t,Active,0,0,1);
-  CREATE_CHAR(uint32_t,ActiveIdentifier,0,0,255);
-  CREATE_CHAR(uint8_t,AirQuality,0,0,5);
-  CREATE_CHAR(uint8_t,BatteryLevel,0,0,100);
-  CREATE_CHAR(int,Brightness,0,0,100);
-  CREATE_CHAR(double,CarbonMonoxideLevel,0,0,100);
-  CREATE_CHAR(double,CarbonMonoxidePeakLevel,0,0,100);
-  CREATE_CHAR(uint8_t,CarbonMonoxideDetected,0,0,1);
-  CREATE_CHAR(double,CarbonDioxideLevel,0,0,100000);
-  CREATE_CHAR(double,CarbonDioxidePeakLevel,0,0,100000);
-  CREATE_CHAR(uint8_t,CarbonDioxideDetected,0,0,1);
-  CREATE_CHAR(uint8_t,ChargingState,0,0,2);
-  CREATE_CHAR(uint8_t,ClosedCaptions,0,0,1);
-  CREATE_CHAR(double,CoolingThresholdTemperature,10,10,35); 
-  CREATE_CHAR(uint32_t,ColorTemperature,200,140,500);
-  CREATE_CHAR(uint8_t,ContactSensorState,1,0,1);
-  CREATE_CHAR(const char *,ConfiguredName,"unnamed",0,1);
-  CREATE_CHAR(double,CurrentAmbientLightLevel,1,0.0001,100000);
-  CREATE_CHAR(int,CurrentHorizontalTiltAngle,0,-90,90);
-  CREATE_CHAR(uint8_t,CurrentAirPurifierState,1,0,2);
-  CREATE_CHAR(uint8_t,CurrentSlatState,0,0,2);
-  CREATE_CHAR(uint8_t,CurrentPosition,0,0,100);
-  CREATE_CHAR(int,CurrentVerticalTiltAngle,0,-90,90);
-  CREATE_CHAR(uint8_t,CurrentVisibilityState,0,0,1);
-  CREATE_CHAR(uint8_t,CurrentHumidifierDehumidifierState,1,0,3);
-  CREATE_CHAR(uint8_t,CurrentDoorState,1,0,4);
-  CREATE_CHAR(uint8_t,CurrentFanState,1,0,2);
-  CREATE_CHAR(uint8_t,CurrentHeatingCoolingState,0,0,2);
-  CREATE_CHAR(uint8_t,CurrentHeaterCoolerState,1,0,3);
-  CREATE_CHAR(uint8_t,CurrentMediaState,0,0,5);
-  CREATE_CHAR(double,CurrentRelativeHumidity,0,0,100);
-  CREATE_CHAR(double,CurrentTemperature,0,0,100);
-  CREATE_CHAR(int,CurrentTiltAngle,0,-90,90);
-//  CREATE_CHAR(tlv8,DisplayOrder,0,0,1);
-  CREATE_CHAR(double,FilterLifeLevel,0,0,100);
-  CREATE_CHAR(uint8_t,FilterChangeIndication,0,0,1);
-  CREATE_CHAR(const char *,FirmwareRevision,"1.0.0",0,1);
-  CREATE_CHAR(const char *,HardwareRevision,"1.0.0",0,1);
-  CREATE_CHAR(double,HeatingThresholdTemperature,16,0,25);
-  CREATE_CHAR(boolean,HoldPosition,false,0,1);
-  CREATE_CHAR(double,Hue,0,0,360);
-  CREATE_CHAR(boolean,Identify,false,0,1);
-  CREATE_CHAR(uint32_t,Identifier,0,0,255);
-  CREATE_CHAR(uint8_t,InputDeviceType,0,0,6);
-  CREATE_CHAR(uint8_t,InputSourceType,0,0,10);
-  CREATE_CHAR(uint8_t,InUse,0,0,1);
-  CREATE_CHAR(uint8_t,IsConfigured,0,0,1);
-  CREATE_CHAR(uint8_t,LeakDetected,0,0,1);
-  CREATE_CHAR(uint8_t,LockCurrentState,0,0,3);
-  CREATE_CHAR(uint8_t,LockPhysicalControls,0,0,1);
-  CREATE_CHAR(uint8_t,LockTargetState,0,0,1);
-  CREATE_CHAR(const char *,Manufacturer,"HomeSpan",0,1);
-  CREATE_CHAR(const char *,Model,"HomeSpan-ESP32",0,1);
-  CREATE_CHAR(boolean,MotionDetected,false,0,1);
-  CREATE_CHAR(boolean,Mute,false,0,1);
-  CREATE_CHAR(const char *,Name,"unnamed",0,1);
-  CREATE_CHAR(double,NitrogenDioxideDensity,0,0,1000);
-  CREATE_CHAR(boolean,ObstructionDetected,false,0,1);
-  CREATE_CHAR(double,PM25Density,0,0,1000);
-  CREATE_CHAR(uint8_t,OccupancyDetected,0,0,1);
-  CREATE_CHAR(boolean,OutletInUse,false,0,1);
-  CREATE_CHAR(boolean,On,false,0,1);
-  CREATE_CHAR(double,OzoneDensity,0,0,1000);
-  CREATE_CHAR(uint8_t,PictureMode,0,0,13);
-  CREATE_CHAR(double,PM10Density,0,0,1000);
-  CREATE_CHAR(uint8_t,PositionState,2,0,2);
-  CREATE_CHAR(uint8_t,PowerModeSelection,0,0,1);
-  CREATE_CHAR(uint8_t,ProgramMode,0,0,2);
-  CREATE_CHAR(uint8_t,ProgrammableSwitchEvent,0,0,2);
-  CREATE_CHAR(double,RelativeHumidityDehumidifierThreshold,50,0,100);
-  CREATE_CHAR(double,RelativeHumidityHumidifierThreshold,50,0,100);
-  CREATE_CHAR(uint32_t,RemainingDuration,60,0,3600);
-  CREATE_CHAR(uint8_t,RemoteKey,0,0,16);
-  CREATE_CHAR(uint8_t,ResetFilterIndication,0,1,1);
-  CREATE_CHAR(int,RotationDirection,0,0,1);
-  CREATE_CHAR(double,RotationSpeed,0,0,100);
-  CREATE_CHAR(double,Saturation,0,0,100);
-  CREATE_CHAR(uint8_t,SecuritySystemAlarmType,0,0,1);
-  CREATE_CHAR(uint8_t,SecuritySystemCurrentState,3,0,4);
-  CREATE_CHAR(uint8_t,SecuritySystemTargetState,3,0,3); 
-  CREATE_CHAR(const char *,SerialNumber,"HS-12345",0,1);
-  CREATE_CHAR(uint8_t,ServiceLabelIndex,1,1,255);
-  CREATE_CHAR(uint8_t,ServiceLabelNamespace,1,0,1);
-  CREATE_CHAR(uint8_t,SlatType,0,0,1);
-  CREATE_CHAR(uint8_t,SleepDiscoveryMode,0,0,1);
-  CREATE_CHAR(uint8_t,SmokeDetected,0,0,1);
-  CREATE_CHAR(boolean,StatusActive,true,0,1);
-  CREATE_CHAR(uint8_t,StatusFault,0,0,1);
-  CREATE_CHAR(uint8_t,StatusJammed,0,0,1);
-  CREATE_CHAR(uint8_t,StatusLowBattery,0,0,1);
-  CREATE_CHAR(uint8_t,StatusTampered,0,0,1);
-  CREATE_CHAR(double,SulphurDioxideDensity,0,0,1000);
-  CREATE_CHAR(uint8_t,SwingMode,0,0,1);
-  CREATE_CHAR(uint8_t,TargetAirPurifierState,1,0,1);
-  CREATE_CHAR(uint8_t,TargetFanState,1,0,1);
-  CREATE_CHAR(int,TargetTiltAngle,0,-90,90);
-  CREATE_CHAR(uint8_t,TargetHeaterCoolerState,0,0,2);
-  CREATE_CHAR(uint32_t,SetDuration,60,0,3600);
-  CREATE_CHAR(int,TargetHorizontalTiltAngle,0,-90,90);
-  CREATE_CHAR(uint8_t,TargetHumidifierDehumidifierState,0,0,2);
-  CREATE_CHAR(uint8_t,TargetPosition,0,0,100);
-  CREATE_CHAR(uint8_t,TargetDoorState,1,0,1);
-  CREATE_CHAR(uint8_t,TargetHeatingCoolingState,0,0,3);
-  CREATE_CHAR(uint8_t,TargetMediaState,0,0,2);
-  CREATE_CHAR(double,TargetRelativeHumidity,0,0,100);
-  CREATE_CHAR(double,TargetTemperature,16,10,38);
-  CREATE_CHAR(uint8_t,TargetVisibilityState,0,0,1);
-  CREATE_CHAR(uint8_t,TemperatureDisplayUnits,0,0,1);
-  CREATE_CHAR(int,TargetVerticalTiltAngle,0,-90,90);
-  CREATE_CHAR(uint8_t,ValveType,0,0,3);
-  CREATE_CHAR(const char *,Version,"1.0.0",0,1);
-  CREATE_CHAR(double,VOCDensity,0,0,1000);
-  CREATE_CHAR(uint8_t,Volume,0,0,100);
-  CREATE_CHAR(uint8_t,VolumeControlType,0,0,3);
-  CREATE_CHAR(uint8_t,VolumeSelector,0,0,1);
-  CREATE_CHAR(double,WaterLevel,0,0,100);
+  CREATE_CHAR(uint8_t,Active,0);
+  CREATE_CHAR(uint32_t,ActiveIdentifier,0);
+  CREATE_CHAR(uint8_t,AirQuality,0);
+  CREATE_CHAR(uint8_t,BatteryLevel,0);
+  CREATE_CHAR(int,Brightness,0);
+  CREATE_CHAR(double,CarbonMonoxideLevel,0);
+  CREATE_CHAR(double,CarbonMonoxidePeakLevel,0);
+  CREATE_CHAR(uint8_t,CarbonMonoxideDetected,0);
+  CREATE_CHAR(double,CarbonDioxideLevel,0);
+  CREATE_CHAR(double,CarbonDioxidePeakLevel,0);
+  CREATE_CHAR(uint8_t,CarbonDioxideDetected,0);
+  CREATE_CHAR(uint8_t,ChargingState,0);
+  CREATE_CHAR(uint8_t,ClosedCaptions,0);
+  CREATE_CHAR(double,CoolingThresholdTemperature,10); 
+  CREATE_CHAR(uint32_t,ColorTemperature,200);
+  CREATE_CHAR(uint8_t,ContactSensorState,1);
+  CREATE_CHAR(const char *,ConfiguredName,"unnamed");
+  CREATE_CHAR(double,CurrentAmbientLightLevel,1);
+  CREATE_CHAR(int,CurrentHorizontalTiltAngle,0);
+  CREATE_CHAR(uint8_t,CurrentAirPurifierState,1);
+  CREATE_CHAR(uint8_t,CurrentSlatState,0);
+  CREATE_CHAR(uint8_t,CurrentPosition,0);
+  CREATE_CHAR(int,CurrentVerticalTiltAngle,0);
+  CREATE_CHAR(uint8_t,CurrentVisibilityState,0);
+  CREATE_CHAR(uint8_t,CurrentHumidifierDehumidifierState,1);
+  CREATE_CHAR(uint8_t,CurrentDoorState,1);
+  CREATE_CHAR(uint8_t,CurrentFanState,1);
+  CREATE_CHAR(uint8_t,CurrentHeatingCoolingState,0);
+  CREATE_CHAR(uint8_t,CurrentHeaterCoolerState,1);
+  CREATE_CHAR(uint8_t,CurrentMediaState,0);
+  CREATE_CHAR(double,CurrentRelativeHumidity,0);
+  CREATE_CHAR(double,CurrentTemperature,0);
+  CREATE_CHAR(int,CurrentTiltAngle,0);
+//  CREATE_CHAR(tlv8,DisplayOrder,0);
+  CREATE_CHAR(double,FilterLifeLevel,0);
+  CREATE_CHAR(uint8_t,FilterChangeIndication,0);
+  CREATE_CHAR(const char *,FirmwareRevision,"1.0.0");
+  CREATE_CHAR(const char *,HardwareRevision,"1.0.0");
+  CREATE_CHAR(double,HeatingThresholdTemperature,16);
+  CREATE_CHAR(boolean,HoldPosition,false);
+  CREATE_CHAR(double,Hue,0);
+  CREATE_CHAR(boolean,Identify,false);
+  CREATE_CHAR(uint32_t,Identifier,0);
+  CREATE_CHAR(uint8_t,InputDeviceType,0);
+  CREATE_CHAR(uint8_t,InputSourceType,0);
+  CREATE_CHAR(uint8_t,InUse,0);
+  CREATE_CHAR(uint8_t,IsConfigured,0);
+  CREATE_CHAR(uint8_t,LeakDetected,0);
+  CREATE_CHAR(uint8_t,LockCurrentState,0);
+  CREATE_CHAR(uint8_t,LockPhysicalControls,0);
+  CREATE_CHAR(uint8_t,LockTargetState,0);
+  CREATE_CHAR(const char *,Manufacturer,"HomeSpan");
+  CREATE_CHAR(const char *,Model,"HomeSpan-ESP32");
+  CREATE_CHAR(boolean,MotionDetected,false);
+  CREATE_CHAR(boolean,Mute,false);
+  CREATE_CHAR(const char *,Name,"unnamed");
+  CREATE_CHAR(double,NitrogenDioxideDensity,0);
+  CREATE_CHAR(boolean,ObstructionDetected,false);
+  CREATE_CHAR(double,PM25Density,0);
+  CREATE_CHAR(uint8_t,OccupancyDetected,0);
+  CREATE_CHAR(boolean,OutletInUse,false);
+  CREATE_CHAR(boolean,On,false);
+  CREATE_CHAR(double,OzoneDensity,0);
+  CREATE_CHAR(uint8_t,PictureMode,0);
+  CREATE_CHAR(double,PM10Density,0);
+  CREATE_CHAR(uint8_t,PositionState,2);
+  CREATE_CHAR(uint8_t,PowerModeSelection,0);
+  CREATE_CHAR(uint8_t,ProgramMode,0);
+  CREATE_CHAR(uint8_t,ProgrammableSwitchEvent,0);
+  CREATE_CHAR(double,RelativeHumidityDehumidifierThreshold,50);
+  CREATE_CHAR(double,RelativeHumidityHumidifierThreshold,50);
+  CREATE_CHAR(uint32_t,RemainingDuration,60);
+  CREATE_CHAR(uint8_t,RemoteKey,0);
+  CREATE_CHAR(uint8_t,ResetFilterIndication,0);
+  CREATE_CHAR(int,RotationDirection,0);
+  CREATE_CHAR(double,RotationSpeed,0);
+  CREATE_CHAR(double,Saturation,0);
+  CREATE_CHAR(uint8_t,SecuritySystemAlarmType,0);
+  CREATE_CHAR(uint8_t,SecuritySystemCurrentState,3);
+  CREATE_CHAR(uint8_t,SecuritySystemTargetState,3); 
+  CREATE_CHAR(const char *,SerialNumber,"HS-12345");
+  CREATE_CHAR(uint8_t,ServiceLabelIndex,1);
+  CREATE_CHAR(uint8_t,ServiceLabelNamespace,1);
+  CREATE_CHAR(uint8_t,SlatType,0);
+  CREATE_CHAR(uint8_t,SleepDiscoveryMode,0);
+  CREATE_CHAR(uint8_t,SmokeDetected,0);
+  CREATE_CHAR(boolean,StatusActive,true);
+  CREATE_CHAR(uint8_t,StatusFault,0);
+  CREATE_CHAR(uint8_t,StatusJammed,0);
+  CREATE_CHAR(uint8_t,StatusLowBattery,0);
+  CREATE_CHAR(uint8_t,StatusTampered,0);
+  CREATE_CHAR(double,SulphurDioxideDensity,0);
+  CREATE_CHAR(uint8_t,SwingMode,0);
+  CREATE_CHAR(uint8_t,TargetAirPurifierState,1);
+  CREATE_CHAR(uint8_t,TargetFanState,1);
+  CREATE_CHAR(int,TargetTiltAngle,0);
+  CREATE_CHAR(uint8_t,TargetHeaterCoolerState,0);
+  CREATE_CHAR(uint32_t,SetDuration,60);
+  CREATE_CHAR(int,TargetHorizontalTiltAngle,0);
+  CREATE_CHAR(uint8_t,TargetHumidifierDehumidifierState,0);
+  CREATE_CHAR(uint8_t,TargetPosition,0);
+  CREATE_CHAR(uint8_t,TargetDoorState,1);
+  CREATE_CHAR(uint8_t,TargetHeatingCoolingState,0);
+  CREATE_CHAR(uint8_t,TargetMediaState,0);
+  CREATE_CHAR(double,TargetRelativeHumidity,0);
+  CREATE_CHAR(double,TargetTemperature,16);
+  CREATE_CHAR(uint8_t,TargetVisibilityState,0);
+  CREATE_CHAR(uint8_t,TemperatureDisplayUnits,0);
+  CREATE_CHAR(int,TargetVerticalTiltAngle,0);
+  CREATE_CHAR(uint8_t,ValveType,0);
+  CREATE_CHAR(const char *,Version,"1.0.0");
+  CREATE_CHAR(double,VOCDensity,0);
+  CREATE_CHAR(uint8_t,Volume,0);
+  CREATE_CHAR(uint8_t,VolumeControlType,0);
+  CREATE_CHAR(uint8_t,VolumeSelector,0);
+  CREATE_CHAR(double,WaterLevel,0);
 
 }
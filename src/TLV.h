@@ -30,34 +30,41 @@
 template <class tagType, int maxTags>
 class TLV {
 
-  int cLen;              // total number of bytes in all defined TLV records, including TAG andf LEN (suitable for use as Content-Length in HTTP Body)
+  static_assert(maxTags<256,"TLV can hold no more than 255 records");
+
   int numTags;           // actual number of tags defined
   
   struct tlv_t {
     tagType tag;         // TAG
-    int len;             // LENGTH
-    uint8_t *val;        // VALUE buffer
-    int maxLen;          // maximum length of VALUE buffer
+    int len;             // LENGTH (-1 if record is not present)
+    uint8_t *val;        // VALUE - points either into buffer that was unpacked, or into scratch buffer if record was written (NULL if record is not present)
+    int maxLen;          // maximum allowed length of VALUE
     const char *name;          // abbreviated name of this TAG
   };
 
   tlv_t tlv[maxTags];           // pointer to array of TLV record structures
+  uint8_t slot[256];            // maps each possible TAG value to 1+index of its TLV record in tlv[] (0 if TAG has not been created)
   tlv_t *find(tagType tag);     // returns pointer to TLV record with matching TAG (or NULL if no match)
 
+  uint8_t *scratch=NULL;        // scratch buffer from which VALUE storage is allocated for records that are written
+  int scratchSize=0;            // size of scratch buffer
+  int scratchUsed=0;            // number of bytes already allocated from scratch buffer
+
 public:
 
   TLV();
   
   int create(tagType tag, int maxLen, const char *name);   // creates a new TLV record of type 'tag' with 'maxLen' bytes and display 'name'
+  void setBuffer(uint8_t *buf, int size);                  // sets scratch buffer used to store VALUEs of records that are written (must remain valid until records are packed)
   
   void clear();                             // clear all TLV structures
   int val(tagType tag);                     // returns VAL for TLV with matching TAG (or -1 if no match)
   int val(tagType tag, uint8_t val);        // sets and returns VAL for TLV with matching TAG (or -1 if no match)    
-  uint8_t *buf(tagType tag);                // returns VAL Buffer for TLV with matching TAG (or NULL if no match)
-  uint8_t *buf(tagType tag, int len);       // set length and returns VAL Buffer for TLV with matching TAG (or NULL if no match or if LEN>MAX)
+  uint8_t *buf(tagType tag);                // returns VAL Buffer for TLV with matching TAG (or NULL if no match or if TLV is not present)
+  uint8_t *buf(tagType tag, int len);       // set length and returns VAL Buffer for TLV with matching TAG (or NULL if no match, if LEN>MAX, or if scratch buffer is full)
   int len(tagType tag);                     // returns LEN for TLV matching TAG (or 0 if TAG is found but LEN not yet set; -1 if no match at all)
-  void print();                             // prints all defined TLVs (those with length>0). For diagnostics/debugging only
-  int unpack(uint8_t *tlvBuf, int nBytes);  // unpacks nBytes of TLV content from single byte buffer into individual TLV records (return 1 on success, 0 if fail) 
+  void print(Print &out=Serial);            // prints all defined TLVs (those with length>0) to 'out'. For diagnostics/debugging only
+  int unpack(uint8_t *tlvBuf, int nBytes);  // unpacks nBytes of TLV content in place, reassembling fragmented records within tlvBuf itself, which must remain valid while records are read (return 1 on success, 0 if fail) 
   int pack(uint8_t *tlvBuf);                // if tlvBuf!=NULL, packs all defined TLV records (LEN>0) into a single byte buffer, spitting large TLVs into separate 255-byte chunks.  Returns number of bytes (that would be) stored in buffer
   int pack_old(uint8_t *buf);               // packs all defined TLV records (LEN>0) into a single byte buffer, spitting large TLVs into separate 255-byte records.  Returns number of bytes stored in buffer
   
@@ -69,6 +76,7 @@ public:
 template<class tagType, int maxTags>
 TLV<tagType, maxTags>::TLV(){
   numTags=0;
+  memset(slot,0,sizeof(slot));
 }
 
 //////////////////////////////////////
@@ -88,24 +96,31 @@ int TLV<tagType, maxTags>::create(tagType tag, int maxLen, const char *name){
   tlv[numTags].maxLen=maxLen;
   tlv[numTags].name=name;
   tlv[numTags].len=-1;
-  tlv[numTags].val=(uint8_t *)malloc(maxLen);
-  numTags++;
+  tlv[numTags].val=NULL;
+  slot[(uint8_t)tag]=++numTags;
 
   return(1);
 }
 
+//////////////////////////////////////
+// TLV setBuffer(buf, size)
+
+template<class tagType, int maxTags>
+void TLV<tagType, maxTags>::setBuffer(uint8_t *buf, int size){
+  scratch=buf;
+  scratchSize=size;
+  scratchUsed=0;
+}
+
 //////////////////////////////////////
 // TLV find(tag)
 
 template<class tagType, int maxTags>
 typename TLV<tagType, maxTags>::tlv_t *TLV<tagType, maxTags>::find(tagType tag){
 
-  for(int i=0;i<numTags;i++){
-    if(tlv[i].tag==tag)
-      return(tlv+i);
-  }
-  
-  return(NULL);
+  uint8_t n=slot[(uint8_t)tag];      // direct lookup - no need to search through records
+
+  return(n?tlv+n-1:NULL);
 }
 
 //////////////////////////////////////
@@ -114,10 +129,12 @@ typename TLV<tagType, maxTags>::tlv_t *TLV<tagType, maxTags>::find(tagType tag){
 template<class tagType, int maxTags>
 void TLV<tagType, maxTags>::clear(){
 
-  cLen=0;
+  scratchUsed=0;
 
-  for(int i=0;i<numTags;i++)
+  for(int i=0;i<numTags;i++){
     tlv[i].len=-1;
+    tlv[i].val=NULL;
+  }
 
 }
 
@@ -141,12 +158,10 @@ int TLV<tagType, maxTags>::val(tagType tag){
 template<class tagType, int maxTags>
 int TLV<tagType, maxTags>::val(tagType tag, uint8_t val){
 
-  tlv_t *tlv=find(tag);
+  uint8_t *v=buf(tag,1);
   
-  if(tlv){
-    tlv->val[0]=val;
-    tlv->len=1;
-    cLen+=tlv->len+2;
+  if(v){
+    v[0]=val;
     return(val);
   }
   
@@ -175,41 +190,52 @@ uint8_t *TLV<tagType, maxTags>::buf(tagType tag, int len){
 
   tlv_t *tlv=find(tag);
   
-  if(tlv && len<=tlv->maxLen){
-    tlv->len=len;
-    cLen+=tlv->len;
+  if(!tlv || len>tlv->maxLen)
+    return(NULL);
 
-    for(int i=0;i<tlv->len;i+=255)
-      cLen+=2;
-    
+  if(tlv->val && len<=tlv->len){          // record already has room for VALUE - simply shorten LEN
+    tlv->len=len;
     return(tlv->val);
   }
-  
-  return(NULL);
+
+  if(scratchUsed+len>scratchSize){
+    Serial.print("\n*** ERROR: Can't allocate ");
+    Serial.print(len);
+    Serial.print(" bytes for TLV record '");
+    Serial.print(tlv->name);
+    Serial.print("' - scratch buffer is full\n\n");
+    return(NULL);
+  }
+
+  tlv->val=scratch+scratchUsed;
+  tlv->len=len;
+  scratchUsed+=len;
+    
+  return(tlv->val);
 }
 
 //////////////////////////////////////
 // TLV print()
 
 template<class tagType, int maxTags>
-void TLV<tagType, maxTags>::print(){
+void TLV<tagType, maxTags>::print(Print &out){
 
   char buf[3];
 
   for(int i=0;i<numTags;i++){
     
     if(tlv[i].len>0){
-      Serial.print(tlv[i].name);
-      Serial.print("(");
-      Serial.print(tlv[i].len);
-      Serial.print(") ");
+      out.print(tlv[i].name);
+      out.print("(");
+      out.print(tlv[i].len);
+      out.print(") ");
       
       for(int j=0;j<tlv[i].len;j++){
         sprintf(buf,"%02X",tlv[i].val[j]);
-        Serial.print(buf);
+        out.print(buf);
        }
 
-      Serial.print("\n");
+      out.print("\n");
 
     } // len>0
   } // loop over all TLVs
@@ -265,54 +291,48 @@ int TLV<tagType, maxTags>::unpack(uint8_t *tlvBuf, int nBytes){
 
   clear();
 
-  tagType tag;
-  int tagLen;
-  uint8_t *val;
-  int currentLen;
-  int state=0;
-
-  for(int i=0;i<nBytes;i++){
+  tlv_t *last=NULL;       // last record unpacked
+  int lastLen=0;          // length of last fragment unpacked
+  int n=0;                // number of bytes of VALUE data compacted at start of tlvBuf
+
+  for(int i=0;i<nBytes;){
+
+    if(i+2>nBytes){                               // not enough bytes for TAG and LEN
+      clear();
+      return(0);
+    }
+
+    tlv_t *tlv=find((tagType)tlvBuf[i]);          // read TAG
+    int tagLen=tlvBuf[i+1];                       // read LEN
+    i+=2;
+
+    if(!tlv || i+tagLen>nBytes){                  // unknown TAG, or not enough bytes for VALUE
+      clear();
+      return(0);
+    }
+
+    if(tlv!=last || lastLen<255){                 // start of new record (otherwise it is a continuation of a record split into 255-byte fragments)
+      if(tlv->len>=0){                            // TAG is repeated but is not contiguous with prior fragment
+        clear();
+        return(0);
+      }
+      tlv->val=tlvBuf+n;
+      tlv->len=0;
+    }
+
+    if(tlv->len+tagLen>tlv->maxLen){              // exceeds maximum length for this TAG
+      clear();
+      return(0);
+    }
+
+    memmove(tlvBuf+n,tlvBuf+i,tagLen);            // move VALUE down over prior TAG/LEN bytes so that fragments are reassembled in place
+    n+=tagLen;
+    i+=tagLen;
+    tlv->len+=tagLen;
+    last=tlv;
+    lastLen=tagLen;
     
-    switch(state){
-      
-      case 0:                                     // ready to read next tag
-        if((tag=(tagType)tlvBuf[i])==-1){         // read TAG; return with error if not found
-          clear();
-          return(0);
-        }
-        state=1;
-      break;
-
-      case 1:                                     // ready to read tag length
-        tagLen=tlvBuf[i];                         // read LEN
-        currentLen=len(tag);                      // get current length of existing tag
-        if(!(val=buf(tag,tagLen+currentLen))){    // get VAL Buffer for TAG and set LEN (returns NULL if LEN > maxLen)
-          clear();
-          return(0);
-        }
-
-        val+=currentLen;                          // move val to end of current length (tag repeats to load more than 255 bytes)
-          
-        if(tagLen==0)                             // no bytes to read
-          state=0;
-        else                                      // move to next state
-          state=2;
-      break;
-
-      case 2:                                     // ready to read another byte into VAL
-        *val=tlvBuf[i];                           // copy byte into VAL buffer
-        val++;                                    // increment VAL buffer (already checked for sufficient length above)
-        tagLen--;                                 // decrement number of bytes to continue copying
-        if(tagLen==0)                             // no more bytes to copy
-          state=0;
-      break;
-
-    } // switch
   } // for-loop
 
-  if(state==0)            // should always end back in state=0
-    return(1);            // return success
-
-  clear();
-  return(0);              // return fail
+  return(1);            // return success
 }
@@ -34,6 +34,10 @@
 //  Utils::readSerial       - reads all characters from Serial port and saves only up to max specified
 //  Utils::mask             - masks a string with asterisks (good for displaying passwords)
 //
+//  class SerialLine        - accumulates characters from Serial port into a line without blocking (defined in Utils.h)
+//  struct HeapTag          - wraps malloc, calloc, realloc, and free to track allocation counts and bytes for each HomeSpan subsystem
+//  class Histogram         - records values (such as latencies) into log-linear buckets for computing percentiles
+//  class SerialBuffer      - buffers output in a ring that is written to the Serial port by a background task
 //  class PushButton        - tracks Single, Double, and Long Presses of a pushbutton that connects a specified pin to ground
 //  class Blinker           - creates customized blinking patterns on an LED connected to a specified pin
 //
@@ -81,6 +85,265 @@ String Utils::mask(char *c, int n){
   return(s);  
 } // mask
 
+////////////////////////////////
+//          HeapTag           //
+////////////////////////////////
+
+const char *HeapTag::names[N_TAGS]={"Database","HAP Slots","TX Queue","Temp Buffers","Network"};
+HeapTag::usage_t HeapTag::usage[N_TAGS];
+
+//////////////////////////////////////
+
+void HeapTag::track(tag_t tag, size_t size){
+
+  usage_t *u=usage+tag;
+  u->nAllocs++;
+  u->nTotal++;
+  u->bytes+=size;
+  if(u->bytes>u->peak)
+    u->peak=u->bytes;
+}
+
+//////////////////////////////////////
+
+void HeapTag::untrack(tag_t tag, size_t size){
+
+  usage_t *u=usage+tag;
+  u->nAllocs--;
+  u->bytes-=size;
+}
+
+//////////////////////////////////////
+
+void *HeapTag::malloc(tag_t tag, size_t size){
+
+  header_t *h=(header_t *)::malloc(sizeof(header_t)+size);
+
+  if(!h)
+    return(NULL);
+
+  h->size=size;
+  track(tag,size);
+  return(h+1);
+}
+
+//////////////////////////////////////
+
+void *HeapTag::calloc(tag_t tag, size_t n, size_t size){
+
+  if(size && n>(SIZE_MAX-sizeof(header_t))/size)      // request would overflow
+    return(NULL);
+
+  void *p=malloc(tag,n*size);
+
+  if(p)
+    memset(p,0,n*size);
+
+  return(p);
+}
+
+//////////////////////////////////////
+
+void *HeapTag::realloc(tag_t tag, void *ptr, size_t size){
+
+  if(!ptr)
+    return(malloc(tag,size));
+
+  if(!size){
+    free(tag,ptr);
+    return(NULL);
+  }
+
+  header_t *h=(header_t *)ptr-1;
+  size_t oldSize=h->size;
+  h=(header_t *)::realloc(h,sizeof(header_t)+size);
+
+  if(!h)                          // realloc failed - original block is unchanged
+    return(NULL);
+
+  h->size=size;
+  untrack(tag,oldSize);           // original block may have been moved
+  track(tag,size);
+  return(h+1);
+}
+
+//////////////////////////////////////
+
+void HeapTag::free(tag_t tag, void *ptr){
+
+  if(!ptr)
+    return;
+
+  header_t *h=(header_t *)ptr-1;
+  untrack(tag,h->size);
+  ::free(h);
+}
+
+//////////////////////////////////////
+
+void *HeapTag::newObject(tag_t tag, size_t size){
+
+  void *p=malloc(tag,size);
+  
+  if(p==NULL){
+    Serial.print("\n\n*** FATAL ERROR: Requested allocation of ");
+    Serial.print(size);
+    Serial.print(" bytes failed.  Program Halting.\n\n");
+    while(1);
+  }
+
+  return(p);
+}
+
+////////////////////////////////
+//         Histogram          //
+////////////////////////////////
+
+int Histogram::bucket(uint32_t v){
+
+  if(v<(1<<SUB_BITS))                 // small values each have their own bucket
+    return(v);
+
+  int e=31-__builtin_clz(v);          // position of most significant bit
+  
+  if(e>=MAX_BITS)
+    return(N_BUCKETS-1);
+
+  return(((e-SUB_BITS+1)<<SUB_BITS) + ((v>>(e-SUB_BITS))&((1<<SUB_BITS)-1)));
+}
+
+//////////////////////////////////////
+
+uint32_t Histogram::upper(int b){
+
+  if(b<(1<<SUB_BITS))
+    return(b);
+
+  int e=(b>>SUB_BITS)+SUB_BITS-1;
+  uint32_t sub=b&((1<<SUB_BITS)-1);
+
+  return((1<<e) + ((sub+1)<<(e-SUB_BITS)) - 1);
+}
+
+//////////////////////////////////////
+
+void Histogram::add(uint32_t v){
+  counts[bucket(v)]++;
+  nValues++;
+  sum+=v;
+  if(v>maxValue)
+    maxValue=v;
+}
+
+//////////////////////////////////////
+
+uint32_t Histogram::percentile(float p){
+
+  if(!nValues)
+    return(0);
+
+  uint32_t target=ceil(nValues*p/100.0);
+  if(target<1)
+    target=1;
+  
+  uint32_t n=0;
+  
+  for(int b=0;b<N_BUCKETS;b++){
+    n+=counts[b];
+    if(n>=target)
+      return(upper(b)<maxValue?upper(b):maxValue);
+  }
+
+  return(maxValue);
+}
+
+//////////////////////////////////////
+
+void Histogram::reset(){
+  memset(counts,0,sizeof(counts));
+  nValues=0;
+  sum=0;
+  maxValue=0;
+}
+
+////////////////////////////////
+//        SerialBuffer        //
+////////////////////////////////
+
+boolean SerialBuffer::begin(size_t size, boolean dropWhenFull, Print &out){
+
+  this->dropWhenFull=dropWhenFull;
+  this->out=&out;
+
+  if(!(ring=xRingbufferCreate(size,RINGBUF_TYPE_BYTEBUF)))
+    return(false);
+
+  maxItem=xRingbufferGetMaxItemSize(ring);
+
+  if(xTaskCreate(drainTask,"SerialBuffer",2048,(void *)this,1,NULL)!=pdPASS){
+    vRingbufferDelete(ring);
+    ring=NULL;
+    return(false);
+  }
+
+  return(true);
+}
+
+//////////////////////////////////////
+
+void SerialBuffer::drainTask(void *arg){
+
+  SerialBuffer *b=(SerialBuffer *)arg;
+  size_t n;
+
+  while(1){
+    uint8_t *data=(uint8_t *)xRingbufferReceiveUpTo(b->ring,&n,portMAX_DELAY,128);      // wait for output, and take up to 128 bytes at a time
+    if(data){
+      b->out->write(data,n);
+      vRingbufferReturnItem(b->ring,data);
+      b->nWritten+=n;
+    }
+  }
+}
+
+//////////////////////////////////////
+
+size_t SerialBuffer::write(uint8_t c){
+  return(write(&c,1));
+}
+
+//////////////////////////////////////
+
+size_t SerialBuffer::write(const uint8_t *buf, size_t n){
+
+  if(!ring)                                   // buffer not started - write directly
+    return(out?out->write(buf,n):Serial.write(buf,n));
+
+  for(size_t i=0;i<n;){
+    size_t len=(n-i)<maxItem?(n-i):maxItem;   // ring cannot accept more than maxItem bytes in one piece
+    
+    if(xRingbufferSend(ring,buf+i,len,dropWhenFull?0:portMAX_DELAY)==pdTRUE)
+      nQueued+=len;
+    else
+      nDropped+=len;
+      
+    i+=len;
+  }
+
+  return(n);
+}
+
+//////////////////////////////////////
+
+void SerialBuffer::flush(){
+
+  while(ring && nWritten!=nQueued)
+    delay(1);
+
+  if(out)
+    out->flush();
+}
+
 ////////////////////////////////
 //         PushButton         //
 ////////////////////////////////
@@ -100,24 +363,86 @@ void PushButton::init(uint8_t pin){
   doubleCheck=false;
   this->pin=pin;
   pinMode(pin, INPUT_PULLUP);
+
+  head=0;
+  tail=0;
+  overflow=false;
+  pressed=!digitalRead(pin);
+  lastQueued=pressed;
+  attachInterruptArg(pin,isrEdge,(void *)this,CHANGE);
+}
+
+//////////////////////////////////////
+
+void IRAM_ATTR PushButton::isrEdge(void *arg){
+
+  PushButton *b=(PushButton *)arg;
+  boolean isPressed=!digitalRead(b->pin);
+
+  if(isPressed==b->lastQueued)            // no change from last queued edge (e.g. contact bounce already captured)
+    return;
+
+  b->lastQueued=isPressed;
+  uint8_t next=(b->head+1)%RING_SIZE;
+
+  if(next==b->tail){                      // ring is full --- drop edge and flag overflow so triggered() re-syncs
+    b->overflow=true;
+    return;
+  }
+
+  b->ring[b->head].time=millis();
+  b->ring[b->head].pressed=isPressed;
+  b->head=next;                           // publish edge only after it has been fully written
+}
+
+//////////////////////////////////////
+
+void PushButton::flush(){
+  tail=head;
+  overflow=false;
+  pressed=!digitalRead(pin);
 }
 
 //////////////////////////////////////
 
 boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t doubleTime){
 
-  unsigned long cTime=millis();
+  if(overflow)                                                  // edges were lost --- discard the rest and re-sync with current state of button
+    flush();
+
+  while(tail!=head){                                            // replay each queued edge through state machine at the time it occurred
+    uint32_t eTime=ring[tail].time;
+    
+    if(step(eTime,pressed,singleTime,longTime,doubleTime))      // first advance state machine up to time of edge (edge remains queued if this triggers)
+      return(true);
+      
+    pressed=ring[tail].pressed;
+    tail=(tail+1)%RING_SIZE;
+    
+    if(step(eTime,pressed,singleTime,longTime,doubleTime))      // then apply the edge itself
+      return(true);
+  }
+
+  if(status==0 && !doubleCheck && !pressed)                     // nothing in progress
+    return(false);
+
+  return(step(millis(),pressed,singleTime,longTime,doubleTime));      // advance state machine to current time
+}
+
+//////////////////////////////////////
+
+boolean PushButton::step(uint32_t cTime, boolean isPressed, uint16_t singleTime, uint16_t longTime, uint16_t doubleTime){
 
   switch(status){
     
     case 0:
-      if(doubleCheck && cTime>doubleAlarm){
+      if(doubleCheck && (int32_t)(cTime-doubleAlarm)>0){
         doubleCheck=false;
         pressType=SINGLE;
         return(true);
       }
       
-      if(!digitalRead(pin)){         // button is pressed
+      if(isPressed){                 // button is pressed
         singleAlarm=cTime+singleTime;
         if(!doubleCheck){
           status=1;
@@ -131,15 +456,15 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
   
     case 1:
     case 2:
-      if(digitalRead(pin)){         // button is released          
+      if(!isPressed){                // button is released          
         status=0;
-        if(cTime>singleAlarm){
+        if((int32_t)(cTime-singleAlarm)>0){
           doubleCheck=true;
         }
       } else
       
-      if(cTime>longAlarm){          // button is long-pressed
-        longAlarm=cTime+longTime;
+      if((int32_t)(cTime-longAlarm)>0){       // button is long-pressed
+        longAlarm+=longTime;
         status=3;
         pressType=LONG;
         return(true);
@@ -147,21 +472,21 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
     break;
 
     case 3:
-      if(digitalRead(pin))          // button has been released after a long press
+      if(!isPressed)                 // button has been released after a long press
         status=0;
-      else if(cTime>longAlarm){
-        longAlarm=cTime+longTime;
+      else if((int32_t)(cTime-longAlarm)>0){
+        longAlarm+=longTime;
         pressType=LONG;
         return(true);        
       }
     break;
 
     case 4:    
-      if(digitalRead(pin)){         // button is released          
+      if(!isPressed){                // button is released          
         status=0;
       } else
       
-      if(cTime>singleAlarm){         // button is still pressed
+      if((int32_t)(cTime-singleAlarm)>0){     // button is still pressed
         status=5;
         pressType=DOUBLE;
         doubleCheck=false;
@@ -170,7 +495,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
     break;
 
     case 5:
-      if(digitalRead(pin))          // button has been released after double-click
+      if(!isPressed)                 // button has been released after double-click
         status=0;
      break;
 
@@ -183,7 +508,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
 
 boolean PushButton::primed(){
   
-  if(millis()>singleAlarm && status==1){
+  if(status==1 && (int32_t)(millis()-singleAlarm)>0){
     status=2;
     return(true);
   }
@@ -201,12 +526,20 @@ int PushButton::type(){
 
 void PushButton::wait(){
   while(!digitalRead(pin));
+  flush();
 }
 
 //////////////////////////////////////
 
 void PushButton::reset(){
   status=0;
+  flush();
+}
+
+//////////////////////////////////////
+
+boolean PushButton::idle(){
+  return(status==0 && !doubleCheck && !pressed && head==tail && !overflow);
 }
 
 ////////////////////////////////
@@ -29,6 +29,8 @@
 
 #include <Arduino.h>
 #include <driver/timer.h>
+#include <freertos/ringbuf.h>
+#include <esp_heap_caps.h>
 
 namespace Utils {
 
@@ -37,6 +39,46 @@ String mask(char *c, int n);          // simply utility that creates a String fr
   
 }
 
+////////////////////////////////
+//          HeapTag           //
+////////////////////////////////
+
+struct HeapTag {
+
+  enum tag_t {
+    DATABASE,           // Accessory, Service, and Characteristic objects, plus their string values, custom ranges, and descriptions
+    HAP_SLOTS,          // HAP connection slot table and HAPClient objects
+    TX_QUEUE,           // encrypted bytes queued for clients that are not reading fast enough
+    TEMP_BUFFER,        // TempBuffers holding JSON responses and their encrypted frames
+    NETWORK,            // WiFi network scans and host name
+    N_TAGS
+  };
+
+  struct usage_t {
+    uint32_t nAllocs=0;           // number of allocations currently outstanding
+    uint32_t nTotal=0;            // cumulative number of allocations
+    size_t bytes=0;               // number of bytes currently allocated
+    size_t peak=0;                // largest number of bytes allocated at any one time
+  };
+
+  union header_t {              // placed in front of every block, since the size of an allocated block cannot be queried from the heap in all versions of ESP-IDF
+    size_t size;                // number of bytes requested
+    uint64_t align;             // keeps the block that follows aligned for 64-bit values
+  };
+
+  static const char *names[N_TAGS];       // names of each tag, as printed by the 'm' CLI command
+  static usage_t usage[N_TAGS];           // current usage for each tag
+
+  static void track(tag_t tag, size_t size);                  // adds block of size bytes to usage for tag
+  static void untrack(tag_t tag, size_t size);                // removes block of size bytes from usage for tag
+
+  static void *malloc(tag_t tag, size_t size);                // blocks returned by malloc(), calloc() and realloc() must only be freed or re-allocated with HeapTag
+  static void *calloc(tag_t tag, size_t n, size_t size);
+  static void *realloc(tag_t tag, void *ptr, size_t size);
+  static void free(tag_t tag, void *ptr);
+  static void *newObject(tag_t tag, size_t size);             // same as malloc(), but halts on failure (for use in operator new)
+};
+
 /////////////////////////////////////////////////
 // Creates a temporary buffer that is freed after
 // going out of scope
@@ -45,10 +87,12 @@ template <class bufType>
 struct TempBuffer {
   bufType *buf;
   int nBytes;
+  HeapTag::tag_t tag;
   
-  TempBuffer(size_t len){
+  TempBuffer(size_t len, HeapTag::tag_t tag=HeapTag::TEMP_BUFFER){
     nBytes=len*sizeof(bufType);
-    buf=(bufType *)heap_caps_malloc(nBytes,MALLOC_CAP_8BIT);
+    this->tag=tag;
+    buf=(bufType *)HeapTag::malloc(tag,nBytes);
     if(buf==NULL){
       Serial.print("\n\n*** FATAL ERROR: Requested allocation of ");
       Serial.print(nBytes);
@@ -58,7 +102,7 @@ struct TempBuffer {
    }
 
   ~TempBuffer(){
-    heap_caps_free(buf);
+    HeapTag::free(tag,buf);
   }
 
   int len(){
@@ -67,12 +111,130 @@ struct TempBuffer {
   
 };
 
+/////////////////////////////////////////////////
+// Accumulates characters from the Serial port
+// into a line without blocking
+
+template <int maxChars>
+class SerialLine {
+  char buf[maxChars+1];       // line buffer (+1 for string terminator)
+  int nChars=0;               // number of characters stored so far
+
+  public:
+
+  char *read(){
+    while(Serial.available()){
+      char c=Serial.read();
+      
+      if(c=='\n'){             // line is complete
+        buf[nChars]='\0';
+        nChars=0;
+        return(buf);
+      }
+      
+      if(c!='\r' && nChars<maxChars)     // save any character except carriage return, but do not store more than maxChars
+        buf[nChars++]=c;
+    }
+
+    return(NULL);
+  }
+
+//  Reads all characters currently available from the Serial port without waiting for more to arrive.
+//  Returns a pointer to the null-terminated line once a newline is received (characters beyond
+//  maxChars are discarded), or NULL if the line is not yet complete.  Partial lines are retained
+//  across calls, so read() can be called repeatedly from a polling loop.
+
+};
+
+////////////////////////////////
+//         Histogram          //
+////////////////////////////////
+
+class Histogram {
+
+  static const int SUB_BITS=2;                              // each power-of-two range is split into 2^SUB_BITS equal sub-buckets (values are resolved to within 25%)
+  static const int MAX_BITS=24;                             // values of 2^MAX_BITS or more are all counted in the last bucket
+  static const int N_BUCKETS=(MAX_BITS-SUB_BITS+1)<<SUB_BITS;
+
+  uint32_t counts[N_BUCKETS]={0};    // number of values recorded in each bucket
+  uint32_t nValues=0;                // total number of values recorded
+  uint64_t sum=0;                    // sum of all values recorded
+  uint32_t maxValue=0;               // largest value recorded
+
+  static int bucket(uint32_t v);     // returns bucket in which value v is counted
+  static uint32_t upper(int b);      // returns largest value counted in bucket b
+
+  public:
+
+  void add(uint32_t v);
+
+//  Records value v.  Takes constant time and does not allocate memory, so it can be called on every request.
+
+  uint32_t percentile(float p);
+
+//  Returns the value below which p percent of recorded values fall (e.g. p=99 for the 99th percentile),
+//  rounded up to the upper edge of the bucket in which it is counted, but never larger than largest().
+//  Returns 0 if no values have been recorded.
+
+  uint32_t count(){return(nValues);}                     // returns number of values recorded
+  uint32_t mean(){return(nValues?sum/nValues:0);}         // returns mean of values recorded
+  uint32_t largest(){return(maxValue);}                   // returns largest value recorded
+  void reset();                                           // discards all recorded values
+};
+
+////////////////////////////////
+//        SerialBuffer        //
+////////////////////////////////
+
+class SerialBuffer : public Print {
+
+  RingbufHandle_t ring=NULL;         // FreeRTOS byte ring buffer holding output not yet written
+  size_t maxItem;                    // largest number of bytes that can be sent to ring in one piece
+  Print *out=NULL;                   // destination of buffered output
+  boolean dropWhenFull;              // if true, output that does not fit in ring is discarded; else writer waits for room
+  volatile uint32_t nQueued=0;       // total number of bytes placed in ring
+  volatile uint32_t nWritten=0;      // total number of bytes written from ring to out
+  volatile uint32_t nDropped=0;      // total number of bytes discarded because ring was full
+
+  static void drainTask(void *arg);  // background task that writes contents of ring to out
+
+  public:
+
+  boolean begin(size_t size, boolean dropWhenFull=true, Print &out=Serial);
+
+//  Creates a ring buffer of size bytes and starts a background task that writes its contents to out.
+//  If dropWhenFull is true, any output that does not fit in the buffer is discarded and counted, so
+//  writing never blocks; otherwise writers wait until there is room.  Until begin() succeeds, all output
+//  is written directly to out.  Returns true on success, false if the buffer or task could not be created.
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t n) override;
+
+//  Copies output into the ring buffer (required by Print, so all print() and printf() methods are supported).
+
+  void flush() override;
+
+//  Blocks until all buffered output has been written to out.
+
+  uint32_t dropped(){return(nDropped);}
+
+//  Returns number of bytes discarded because the buffer was full.
+
+};
+
 ////////////////////////////////
 //         PushButton         //
 ////////////////////////////////
 
 class PushButton{
   
+  static const int RING_SIZE=16;   // number of edge events that can be queued by interrupt handler before overflowing
+
+  struct edge_t {
+    uint32_t time;                 // time (in millis) of edge transition
+    boolean pressed;               // state of button after edge transition
+  };
+
   int status;
   uint8_t pin;
   boolean doubleCheck;
@@ -80,6 +242,17 @@ class PushButton{
   uint32_t doubleAlarm;
   uint32_t longAlarm;
   int pressType;
+  boolean pressed;                 // last state of button consumed from ring
+
+  volatile edge_t ring[RING_SIZE]; // lock-free ring of edge events written by isrEdge() and read by triggered()
+  volatile uint8_t head;           // index of next ring slot to be written (updated only by isrEdge)
+  volatile uint8_t tail;           // index of next ring slot to be read (updated only by triggered)
+  volatile boolean lastQueued;     // state of button in most recently queued edge event (used to discard repeats)
+  volatile boolean overflow;       // set by isrEdge() if ring is full and an edge event was dropped
+
+  static void isrEdge(void *arg);  // interrupt handler that timestamps each button transition into ring
+  boolean step(uint32_t cTime, boolean isPressed, uint16_t singleTime, uint16_t longTime, uint16_t doubleTime);     // advances state machine to time cTime with button in state isPressed; returns true if triggered
+  void flush();                    // discards any queued edge events and re-syncs with current state of button
 
   public:
 
@@ -135,6 +308,10 @@ class PushButton{
 //  * If doubleTime=0, Double Presses cannot occur.
 //  * Once triggered() returns true, if will subsequently return false until there is a new trigger event.
 
+//  Button transitions are captured by a GPIO interrupt that timestamps each edge, and triggered() replays these
+//  timestamps through the state machine.  Press classification is therefore accurate regardless of how often
+//  triggered() is called, though the trigger itself is only reported upon the next call.
+
   boolean primed();
 
 //  Returns true if button has been pressed and held for greater than singleTime, but has not yet been released.
@@ -148,6 +325,12 @@ class PushButton{
 
 //  Waits for button to be released.  Use after Long Press if button release confirmation is desired
 
+  boolean idle();
+
+//  Returns true if button is released and no press event is in progress or pending (i.e. a subsequent call
+//  to triggered() cannot return true unless the button is first pressed).  Used by homeSpan.poll() to
+//  determine whether it is safe to block while waiting for new activity
+
 };
 
 ////////////////////////////////
@@ -0,0 +1,57 @@
+// Minimal host stand-in for the Arduino-ESP32 core, providing just enough of the
+// API for src/Utils.cpp to compile and link on a PC.  Pin levels, millis() and the
+// GPIO interrupt are simulated by the test (see PushButtonTest.cpp).
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define INPUT_PULLUP  0x05
+#define OUTPUT        0x03
+#define CHANGE        0x03
+#define HIGH          1
+#define LOW           0
+
+unsigned long millis();
+void delay(uint32_t ms);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+void pinMode(uint8_t pin, uint8_t mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+
+class String {
+  std::string s;
+  public:
+  String(const char *c=""){s=c;}
+  String &operator+=(const char *c){s+=c;return(*this);}
+  String &operator+=(char c){s+=c;return(*this);}
+  const char *c_str() const {return(s.c_str());}
+};
+
+class Print {
+  public:
+  virtual size_t write(uint8_t c)=0;
+  virtual size_t write(const uint8_t *buf, size_t n){size_t k=0;while(n--)k+=write(*buf++);return(k);}
+  template <typename T> size_t print(T){return(0);}
+  virtual void flush(){}
+  virtual ~Print(){}
+};
+
+class HardwareSerial : public Print {
+  public:
+  using Print::write;
+  size_t write(uint8_t){return(1);}
+  int available(){return(0);}
+  int read(){return(-1);}
+};
+
+extern HardwareSerial Serial;
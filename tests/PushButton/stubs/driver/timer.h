@@ -0,0 +1,24 @@
+// Host stand-in for the ESP-IDF general-purpose timer driver (used only by Blinker, which the test does not exercise)
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {TIMER_GROUP_0, TIMER_GROUP_1} timer_group_t;
+typedef enum {TIMER_0, TIMER_1} timer_idx_t;
+
+enum {TIMER_PAUSE, TIMER_ALARM_EN, TIMER_INTR_LEVEL=0, TIMER_COUNT_UP=1, TIMER_AUTORELOAD_EN=1};
+
+typedef struct {int alarm_en, counter_en, intr_type, counter_dir, auto_reload, divider;} timer_config_t;
+typedef struct {struct {int t0, t1;} int_clr_timers;} timg_dev_t;
+
+extern timg_dev_t TIMERG0, TIMERG1;
+
+inline void timer_init(timer_group_t, timer_idx_t, timer_config_t *){}
+inline void timer_isr_register(timer_group_t, timer_idx_t, void (*)(void *), void *, int, void *){}
+inline void timer_enable_intr(timer_group_t, timer_idx_t){}
+inline void timer_set_alarm_value(timer_group_t, timer_idx_t, uint64_t){}
+inline void timer_set_alarm(timer_group_t, timer_idx_t, int){}
+inline void timer_set_counter_value(timer_group_t, timer_idx_t, uint64_t){}
+inline void timer_start(timer_group_t, timer_idx_t){}
+inline void timer_pause(timer_group_t, timer_idx_t){}
@@ -0,0 +1,25 @@
+// Host stand-in for the FreeRTOS ring buffer and task API (used only by SerialBuffer, which the test does not exercise)
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void *RingbufHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+
+typedef enum {RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF} RingbufferType_t;
+
+#define pdPASS        1
+#define pdTRUE        1
+#define portMAX_DELAY 0xFFFFFFFF
+
+inline RingbufHandle_t xRingbufferCreate(size_t, RingbufferType_t){return(NULL);}
+inline size_t xRingbufferGetMaxItemSize(RingbufHandle_t){return(0);}
+inline BaseType_t xRingbufferSend(RingbufHandle_t, const void *, size_t, TickType_t){return(0);}
+inline void *xRingbufferReceiveUpTo(RingbufHandle_t, size_t *, TickType_t, size_t){return(NULL);}
+inline void vRingbufferReturnItem(RingbufHandle_t, void *){}
+inline void vRingbufferDelete(RingbufHandle_t){}
+inline BaseType_t xTaskCreate(void (*)(void *), const char *, uint32_t, void *, uint32_t, TaskHandle_t *){return(0);}